@@ -0,0 +1,51 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "common.h"
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// A bump pointer allocator. Memory is handed out from large blocks and is only given back when
+// the arena itself is destroyed, all at once. Objects made in an arena never have their
+// destructors run, so only trivially destructible types are allowed in it.
+class Arena {
+public:
+    Arena() = default;
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align);
+    void  adopt(Arena& other);
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "objects in an arena are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* make_array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "objects in an arena are never destroyed");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Bytes handed out so far.
+    inline size_t used() const { return bytes_used; }
+private:
+    struct Block {
+        Block* next;
+    };
+
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    Block* blocks = nullptr;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t bytes_used = 0;
+};
+
+#endif // !ARENA_H
@@ -3,6 +3,8 @@
 
 #include "common.h"
 #include "lexer.h"
+#include "symbol.h"
+#include "arena.h"
 
 #include <vector>
 
@@ -28,7 +30,14 @@ enum {
     AST_FOR,
     AST_WHILE,
     AST_RETURN,
-    AST_TRANSLATION_UNIT
+    AST_TRANSLATION_UNIT,
+    AST_FLAT,
+    AST_IMPORT,
+    AST_INLINE,
+    AST_INVARIANT,
+    AST_INCREMENT,
+    AST_INDUCTION,
+    AST_COMMON
 };
 
 enum {
@@ -92,24 +101,98 @@ enum {
 struct Ast;
 struct Ast_Expression;
 struct Ast_Scope;
+struct Ast_FuncDecleration;
+class  Parser;
+class  Resolver;
+struct Ast_VarDecleration;
+
+// A growable array kept in the arena of the translation unit, so the nodes holding one stay trivially
+// destructible. Growing copies the items into a larger array and leaves the old one in the arena.
+template <typename T>
+struct Ast_List {
+    T* items = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+
+    void push_back(Arena& arena, T item) {
+        if (count == capacity) {
+            uint32_t grown = (capacity == 0) ? 4 : capacity * 2;
+            T* larger = arena.make_array<T>(grown);
+            if (count > 0)
+                memcpy(larger, items, sizeof(T) * count);
+            items = larger;
+            capacity = grown;
+        }
+        items[count++] = item;
+    }
+
+    // Replaces removed items from at on with the added ones, growing the array like push_back does.
+    void splice(Arena& arena, uint32_t at, uint32_t removed, const T* with, uint32_t added) {
+        uint32_t total = count - removed + added;
+        T* into = items;
+        if (total > capacity) {
+            capacity = (capacity * 2 > total) ? capacity * 2 : total;
+            into = arena.make_array<T>(capacity);
+            if (at > 0)
+                memcpy(into, items, sizeof(T) * at);
+        }
+        if (count > at + removed)
+            memmove(into + at + added, items + at + removed, sizeof(T) * (count - at - removed));
+        if (added > 0)
+            memcpy(into + at, with, sizeof(T) * added);
+
+        items = into;
+        count = total;
+    }
+
+    inline uint32_t size() const { return count; }
+    inline T& operator[](uint32_t index) const { return items[index]; }
+    inline T* begin() const { return items; }
+    inline T* end() const { return items + count; }
+};
+
+// Where the resolver put a variable: how many frames up from the one using it and its slot in that frame.
+struct Ast_Address {
+    uint32_t depth = 0;
+    uint32_t slot = 0;
+    Ast_VarDecleration* variable = nullptr; // the declaration, null when the name was not found
+};
+
+// Where a top level declaration starts. The nodes under it count their lines from there, so a
+// declaration moved by an edit only has its origin moved.
+struct Ast_Origin {
+    const char* file = nullptr;
+    uint32_t line = 0;
+};
 
 struct Ast {
     Ast() { }
 
 	int type = 0;
-    uint32_t line = 0;
-    const char* file;
+    uint32_t line = 0; // from the line of the origin
+    Ast_Origin* origin = nullptr;
+
+    inline const char* file() const { return origin ? origin->file : nullptr; }
+    inline uint32_t source_line() const { return origin ? origin->line + line : line; }
 };
 
 struct Ast_Expression : Ast {
     Ast_Expression() { type = AST_EXPRESSION; }
+
+    // The type of the value, one of the AST types or AST_VOID for a call to a function without a
+    // return type. Set by the checker, AST_TYPE_NONE when it could not be worked out or is wrong.
+    int value_type = AST_TYPE_NONE;
 };
 
 struct Ast_FunctionCall {
-    Ast_FunctionCall(const char* ident, const std::vector<Ast_Expression*>& args) : ident(ident), args(args) { }
+    Ast_FunctionCall(SymbolId ident, const Ast_List<Ast_Expression*>& args) : ident(ident), args(args) { }
+
+    SymbolId ident;
+    Ast_List<Ast_Expression*> args;
 
-    const char* ident;
-    std::vector<Ast_Expression*> args;
+    // Filled in by the resolver, the function called and how many frames up it was declared.
+    Ast_FuncDecleration* function = nullptr;
+    uint32_t depth = 0;
 };
 
 struct Ast_Cast {
@@ -121,17 +204,18 @@ struct Ast_Cast {
 
 struct Ast_PrimaryExpression : public Ast_Expression {
     Ast_PrimaryExpression() { type = AST_PRIMARY; }
-    Ast_PrimaryExpression(const char* ident) : ident(ident), type_value(AST_ID) { type = AST_PRIMARY; }
+    Ast_PrimaryExpression(SymbolId ident) : ident(ident), type_value(AST_ID) { type = AST_PRIMARY; }
     Ast_PrimaryExpression(_number float_const) : float_const(float_const), type_value(AST_FLOAT) { type = AST_PRIMARY; }
     Ast_PrimaryExpression(char char_const) : char_const(char_const), type_value(AST_CHAR) { type = AST_PRIMARY; }
     
     int type_value = AST_TYPE_NONE;
     int array_size = -1;
+    Ast_Address address; // of an identifier
 
     union {
         int         int_const;
         float       float_const;
-        const char* ident;
+        SymbolId    ident;
         const char* string;
         char        char_const;
         bool        boolean;
@@ -169,13 +253,59 @@ struct Ast_UnaryExpression : public Ast_Expression {
 
 struct Ast_Assignment : public Ast_Expression {
     Ast_Assignment() { type = AST_ASSIGNMENT; }
-    Ast_Assignment(Ast_Expression* expression, const char* id, int equal_type = AST_EQUAL) : expression(expression), id(id), equal_type(equal_type) { type = AST_ASSIGNMENT; }
+    Ast_Assignment(Ast_Expression* expression, SymbolId id, int equal_type = AST_EQUAL) : expression(expression), id(id), equal_type(equal_type) { type = AST_ASSIGNMENT; }
 
     int equal_type = AST_EQUAL;
-    const char* id = nullptr;
+    SymbolId id = SYMBOL_NONE;
+    Ast_Address address;
     Ast_Expression* expression = nullptr;
 };
 
+// A call the optimizer put the body of the function in place of, see inline.cpp. The arguments are
+// worked out into slots of the caller's frame, one after the other from first_slot, and the
+// returned expression reads the parameters from there. A literal argument is put in place of the
+// parameter instead and has no slot.
+struct Ast_InlineCall : public Ast_Expression {
+    Ast_InlineCall() { type = AST_INLINE; }
+
+    Ast_List<Ast_Expression*> args;
+    uint32_t first_slot = 0;
+    Ast_Expression* body = nullptr;
+};
+
+// An expression of a while loop whose value does not change while the loop runs, see hoist.cpp. It
+// is worked out the first time the loop gets to it and kept in a slot of the frame, the uses after
+// that read the slot. The loop makes the slot undefined again each time it starts.
+struct Ast_LoopInvariant : public Ast_Expression {
+    Ast_LoopInvariant(Ast_Expression* expression, uint32_t slot) : expression(expression), slot(slot) { type = AST_INVARIANT; }
+
+    Ast_Expression* expression = nullptr;
+    uint32_t slot = 0;
+};
+
+// A product of a variable a loop only changes by increments and a value that does not change in the
+// loop, see induction.cpp. It is worked out the first time the loop gets to it and kept in a slot,
+// with the invariant side in the slot after it. The increments of the variable keep it up to date
+// from then on, the loop makes the slots undefined again each time it starts.
+struct Ast_Induction : public Ast_Expression {
+    Ast_Induction() { type = AST_INDUCTION; }
+
+    Ast_Expression* left = nullptr;
+    Ast_Expression* right = nullptr;
+    bool variable_left = true; // which side is the variable
+    uint32_t slot = 0;
+};
+
+// An expression worked out more than once in a block with nothing between that changes its value,
+// see common.cpp. The first one works it out into a slot of the frame, the ones after it have no
+// expression and read the slot.
+struct Ast_CommonExpression : public Ast_Expression {
+    Ast_CommonExpression(Ast_Expression* expression, uint32_t slot) : expression(expression), slot(slot) { type = AST_COMMON; }
+
+    Ast_Expression* expression = nullptr;
+    uint32_t slot = 0;
+};
+
 struct Ast_Decleration : public Ast {
     Ast_Decleration() { type = AST_DECLERATION; }
 };
@@ -191,9 +321,24 @@ struct Ast_ExpressionStatement : public Ast_Statement {
 };
 
 struct Ast_PrintStatement : public Ast_Statement {
-    Ast_PrintStatement(const std::vector<Ast_Expression*>& expressions) : expressions(expressions) { type = AST_PRINT; }
+    Ast_PrintStatement(const Ast_List<Ast_Expression*>& expressions) : expressions(expressions) { type = AST_PRINT; }
 
-    std::vector<Ast_Expression*> expressions;
+    Ast_List<Ast_Expression*> expressions;
+};
+
+// x = x + c; or x += c; for an int or float variable and a literal c, done in place on the variable
+// by the interpreter. The inductions of the variable are moved along with it, each by c times the
+// invariant side kept in the slot after its own.
+struct Ast_Increment : public Ast_Statement {
+    Ast_Increment() { type = AST_INCREMENT; }
+
+    Ast_Address address;
+    int value_type = AST_INT;
+    union {
+        int   int_const;
+        float float_const;
+    };
+    Ast_List<uint32_t> inductions; // the slots of the inductions in the frame
 };
 
 struct Ast_ConditionalStatement : public Ast_Statement {
@@ -223,6 +368,14 @@ struct Ast_ElseStatement : Ast_ConditionalStatement {
 struct Ast_WhileLoop : Ast_ConditionalStatement {
     Ast_WhileLoop() { type = AST_WHILE; }
     Ast_WhileLoop(Ast_Expression* condition, Ast_Scope* scope) : Ast_ConditionalStatement(condition, scope) { type = AST_WHILE; }
+
+    // The slots of the invariants hoisted out of the loop, see Ast_LoopInvariant.
+    uint32_t first_invariant = 0;
+    uint32_t invariant_count = 0;
+
+    // The slots of the inductions of the loop's variables, see Ast_Induction.
+    uint32_t first_induction = 0;
+    uint32_t induction_count = 0;
 };
 
 struct Ast_ForLoop : Ast_ConditionalStatement {
@@ -237,30 +390,49 @@ struct Ast_ForLoop : Ast_ConditionalStatement {
 struct Ast_Scope : public Ast_Statement {
     Ast_Scope() { type = AST_SCOPE; }
 
-    std::vector<Ast_Decleration*> declerations;
+    Ast_List<Ast_Decleration*> declerations;
+
+    // The slots of the variables declared in the scope, they are cleared each time it ends.
+    uint32_t first_slot = 0;
+    uint32_t slot_count = 0;
 };
 
 struct Ast_VarDecleration : public Ast_Decleration {
     Ast_VarDecleration() { type = AST_VAR_DECLERATION; }
-    Ast_VarDecleration(const char* ident, Ast_Expression* expression, int type_value, int specifiers) 
+    Ast_VarDecleration(SymbolId ident, Ast_Expression* expression, int type_value, int specifiers) 
         : ident(ident), expression(expression), type_value(type_value), specifiers(specifiers) { type = AST_VAR_DECLERATION; }
 
     int type_value = AST_TYPE_NONE;
     int specifiers = AST_SPECIFIER_NONE;
-    const char* ident = nullptr;
+    SymbolId ident = SYMBOL_NONE;
+    uint32_t slot = 0; // in the frame the declaration is in
 
     Ast_Expression* expression = nullptr;
 };
 
 struct Ast_FuncDecleration : public Ast_Decleration {
     Ast_FuncDecleration() { type = AST_FUNC_DECLERATION; }
-    Ast_FuncDecleration(const char* ident, int return_type, const std::vector<Ast_VarDecleration*> args, Ast_Scope* scope) : 
+    Ast_FuncDecleration(SymbolId ident, int return_type, const Ast_List<Ast_VarDecleration*>& args, Ast_Scope* scope) : 
         ident(ident), return_type(return_type), args(args), scope(scope) { type = AST_FUNC_DECLERATION; }
         
-    const char* ident = nullptr;
+    SymbolId ident = SYMBOL_NONE;
     int return_type = AST_VOID;
-    std::vector<Ast_VarDecleration*> args;
+    Ast_List<Ast_VarDecleration*> args;
     Ast_Scope* scope = nullptr;
+
+    // When the parser skipped the body, scope is null until the first call and this is where 
+    // the body starts in the token list.
+    TokenStore::Cursor body;
+
+    // The slots a call needs for the arguments and every variable in the body, set by the resolver.
+    uint32_t frame_size = 0;
+};
+
+// import "path"; at the top level of a file, see module.h.
+struct Ast_ImportDecleration : public Ast_Decleration {
+    Ast_ImportDecleration(const char* path) : path(path) { type = AST_IMPORT; }
+
+    const char* path = nullptr; // as written, relative to the directory of the importing file
 };
 
 struct Ast_ReturnStatement : Ast_Statement {
@@ -269,12 +441,96 @@ struct Ast_ReturnStatement : Ast_Statement {
     Ast_Expression* expression = nullptr;
 };
 
+// The kinds of nodes in the flat form of an expression.
+enum {
+    AST_FLAT_INT,
+    AST_FLAT_FLOAT,
+    AST_FLAT_CHAR,
+    AST_FLAT_BOOLEAN,
+    AST_FLAT_STRING,
+    AST_FLAT_ID,
+    AST_FLAT_UNARY,
+    AST_FLAT_BINARY,
+    AST_FLAT_CAST,
+    AST_FLAT_TREE    // an expression that was kept as a pointer node (calls, assignments, input and the optimizer's nodes)
+};
+
+// One expression node in the flat form. Children are indices into the same node array and are always
+// stored before their parent. A leaf keeps its value in a: the bits of an int, float, char or boolean, the
+// slot of a variable (with its depth in b), or an index into the strings or trees of the flat expressions.
+//
+// A unary or binary node the checker gave a type keeps the type of its operands, which the
+// interpreter works it out with like it does the tree node, AST_TYPE_NONE for the others.
+struct Ast_FlatNode {
+    uint8_t  kind : 4;
+    uint8_t  type : 4;
+    uint8_t  op;   // the operator of a unary or binary node, the type of a cast
+    uint16_t file; // index into the file table
+    uint32_t a;
+    uint32_t b;
+};
+
+static_assert(AST_FLAT_TREE < 16 && AST_TYPE_NONE < 16, "flat node kinds and types are kept in 4 bits");
+
+// Expression trees stored as contiguous arrays. The line of each node is kept in its own array
+// since it is only looked at when reporting an error. The lines are counted from the start of the
+// file, each file has an origin on line 0.
+struct Ast_FlatExpressions {
+    std::vector<Ast_FlatNode> nodes;
+    std::vector<uint32_t> lines;
+    std::vector<Ast_Origin*> files;
+    std::vector<const char*> strings;
+    std::vector<Ast_Expression*> trees;
+
+    Ast location(uint32_t node) const {
+        Ast ast;
+        ast.line = lines[node];
+        ast.origin = files[nodes[node].file];
+        return ast;
+    }
+
+    inline size_t bytes() const {
+        return nodes.size() * (sizeof(Ast_FlatNode) + sizeof(uint32_t)) + strings.size() * sizeof(const char*) + 
+               trees.size() * sizeof(Ast_Expression*);
+    }
+};
+
+// Stands in for a whole expression tree that was moved into the flat arrays.
+struct Ast_FlatExpression : public Ast_Expression {
+    Ast_FlatExpression(const Ast_FlatExpressions* flat, uint32_t root) : flat(flat), root(root) { type = AST_FLAT; }
+
+    const Ast_FlatExpressions* flat = nullptr;
+    uint32_t root = 0;
+};
+
+// Owns every node of its tree (and their lists and strings) through its arena, dropping the
+// unit frees the whole tree at once.
 struct Ast_TranslationUnit : public Ast {
     Ast_TranslationUnit() { type = AST_TRANSLATION_UNIT; }
 
-    std::vector<Ast_Decleration*> declerations;
+    Arena arena;
+    Ast_List<Ast_Decleration*> declerations;
+
+    // The parser that made the unit, it parses skipped function bodies when they are first called.
+    Parser* parser = nullptr;
+
+    // The resolver that went over the unit, it resolves those bodies after they are parsed. The
+    // frame of the program has frame_size slots.
+    Resolver* resolver = nullptr;
+    uint32_t frame_size = 0;
+
+    // Filled in when the expressions are flattened, see flatten.h.
+    Ast_FlatExpressions flat;
 };
 
+// Whether an expression is a constant written out in the source: an int, float, char, boolean or
+// string. Strings count, null is not a literal.
+bool is_ast_literal(Ast_Expression* expression);
+
+// The number of nodes in a declaration or expression and everything under it.
+uint32_t count_ast_nodes(Ast_Decleration* decleration);
+uint32_t count_ast_nodes(Ast_Expression* expression);
+
 #define AST_DELETE(type) delete type
 
 #define AST_CAST(type, base) static_cast<type*>(base)
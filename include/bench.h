@@ -3,6 +3,8 @@
 
 void begin_debug_benchmark();
 
-void end_debug_benchmark(const char* label);
+float end_debug_benchmark(const char* label);
+
+float debug_benchmark_time();
 
 #endif // !BENCH_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "lexer.h"
+#include "ast.h"
+
+// Parsed programs are kept in a cache directory as .yaplc files, so a script that has not changed
+// is not lexed and parsed again on the next run. A file is named after a hash of the source and
+// the YAPL version, and holds the syntax tree of that source. It is only good for the machine that
+// wrote it, the numbers in it are stored the way this machine stores them.
+
+// Returns the program parsed from the lexer's source out of the cache in dir, or null when it is
+// not there or the file in the cache is not usable.
+Ast_TranslationUnit* load_program_cache(const char* dir, Lexer& lexer);
+
+// Writes the program to the cache in dir. A program with function bodies that were skipped or
+// expressions that were flattened is not written. Returns false if nothing was written.
+bool save_program_cache(const char* dir, Lexer& lexer, Ast_TranslationUnit* unit);
+
+#endif // !CACHE_H
@@ -0,0 +1,45 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "common.h"
+
+#include <vector>
+
+struct Diagnostic {
+    const char* file;
+    uint32_t    line;  // tokens only carry their line, so that is as fine as a span gets
+    const char* msg;   // a string literal, never copied
+};
+
+// Collects the errors of the front end instead of printing them one at a time. They are written
+// out in the order they were found, all in one write, when the sink is flushed or destroyed.
+class DiagnosticSink {
+public:
+    DiagnosticSink() = default;
+    ~DiagnosticSink();
+
+    DiagnosticSink(const DiagnosticSink&) = delete;
+    DiagnosticSink& operator=(const DiagnosticSink&) = delete;
+
+    inline void error(const char* file, uint32_t line, const char* msg) {
+        pending.push_back({ file, line, msg });
+        errors++;
+    }
+
+    void flush();
+    void discard() { pending.clear(); }
+
+    // A held sink keeps its errors through flush() until it is let go, so sinks filled on different
+    // threads can be written out in a fixed order.
+    void hold() { held = true; }
+    void release() { held = false; flush(); }
+
+    // Every error reported so far, flushed or not.
+    inline size_t error_count() const { return errors; }
+private:
+    std::vector<Diagnostic> pending;
+    size_t errors = 0;
+    bool held = false;
+};
+
+#endif // !DIAGNOSTICS_H
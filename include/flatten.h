@@ -0,0 +1,17 @@
+#ifndef FLATTEN_H
+#define FLATTEN_H
+
+#include "ast.h"
+
+struct FlattenStats {
+    uint32_t nodes = 0;       // expression nodes moved into the flat arrays
+    size_t   tree_bytes = 0;  // what those nodes took up as pointer nodes
+};
+
+// Moves the expressions of a translation unit into unit->flat. Every expression whose root can be 
+// flattened is replaced by an Ast_FlatExpression, the interpreter evaluates those straight from 
+// the arrays. Calls, assignments and input stay pointer nodes but their operands are flattened.
+// Variables are flattened with their addresses, so the unit has to be resolved first.
+FlattenStats flatten_translation_unit(Ast_TranslationUnit* unit);
+
+#endif // !FLATTEN_H
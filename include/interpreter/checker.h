@@ -0,0 +1,52 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include "ast.h"
+#include "diagnostics.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+// Goes over the tree after the resolver and works out the type of every expression from the types
+// the variables, arguments and functions were declared with, see Ast_Expression::value_type. What
+// would be a type error when the program gets to it is reported before it runs, and the float an
+// int is turned into when it is the right operand of a float is made an explicit cast.
+//
+// The types follow what the objects of the interpreter do. The operands of a binary operator have
+// the same type, the result has that type too, except for comparisons and the logical and bitwise
+// operators, which give a boolean. An expression that uses a name or function that is not found,
+// or a body the parser skipped, is left without a type and is run the way it always was.
+//
+// The interpreter goes straight to the operation for the type of a typed expression and leaves
+// out the checks on the types of the values, see Interpreter::apply_typed_binary.
+class Checker {
+public:
+    Checker(DiagnosticSink& diagnostics) : diagnostics(diagnostics) { }
+
+    void check(Ast_TranslationUnit* unit);
+
+    // The binary operator a compound assignment applies to its variable and value.
+    static int assignment_operator(int equal_type);
+private:
+    void decleration(Ast_Decleration* decleration);
+    void function(Ast_FuncDecleration* func);
+    int  expression(Ast_Expression* expression);
+    int  primary(Ast_PrimaryExpression* primary);
+    int  call(Ast_FunctionCall* call, const Ast& at);
+    int  binary(int op, int left, Ast_Expression*& right, const Ast& at);
+    int  unary(Ast_UnaryExpression* unary);
+    int  assignment(Ast_Assignment* assign);
+    int  variable(Ast_VarDecleration* var);
+    int  result(Ast_FuncDecleration* func);
+
+    void error(const Ast& at, const char* msg);
+
+    DiagnosticSink& diagnostics;
+    Ast_TranslationUnit* unit = nullptr;
+
+    // The type a call of each function gives, worked out once per function.
+    std::unordered_map<Ast_FuncDecleration*, int> results;
+    std::unordered_set<Ast_VarDecleration*> arguments;
+};
+
+#endif // !CHECKER_H
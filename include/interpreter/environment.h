@@ -4,6 +4,7 @@
 #include "ast.h"
 #include "object.h"
 #include <map>
+#include <vector>
 
 enum {
     EN_ERROR_NONE,
@@ -19,28 +20,45 @@ static std::map<int, const char*> EN_ERROR_MESSAGES {
     { EN_ERROR_WRONG_TYPE_ASSIGN, "Types do not match in assignment" }
 };
 
-struct Environment {
+// The variables of the running program, found by the addresses the resolver gave them. A call gets
+// a frame of slots, all the frames are kept one after the other in one array. Each frame links to
+// the frame of the function (or program) its function was declared in, an address that is depth
+// frames up follows that link depth times.
+class Environment {
+public:
     Environment() = default;
     ~Environment() = default;
 
-    int    var_is_defined(const char* name);
-    void   var_define(const char* name, Object object);
-    int    var_update(const char* name, Object object);
-    bool   var_found(const char* name);
-    Object var_get(const char* name);
+    // A frame is added in two steps, so the arguments of a call can be worked out in the caller's
+    // frame and put straight into the slots of the new one: reserve gives the index of the first of
+    // size undefined slots, enter makes them the current frame. Its link is the frame depth frames
+    // up from the caller's, the first frame has none.
+    uint32_t reserve(uint32_t size);
+    void enter(uint32_t base, uint32_t depth = 0);
+    void pop();
 
-    int func_is_defined(const char* name);
-    void func_define(const char* name, Ast_FuncDecleration* func);
-    bool func_found(const char* name);
-    Ast_FuncDecleration* func_get(const char* name);
+    // Makes count slots of the current frame from first on undefined again.
+    void clear(uint32_t first, uint32_t count);
 
+    // Both hold until the next reserve, slots can move when the array grows.
+    inline Object& slot(uint32_t index) { return slots[index]; }
+    inline Object& var(Ast_Address address) {
+        uint32_t frame = (uint32_t) frames.size() - 1;
+        for (uint32_t i = 0; i < address.depth; i++)
+            frame = frames[frame].enclosing;
+        return slots[frames[frame].base + address.slot];
+    }
+
+    static inline bool var_defined(const Object& object) { return object.error != OBJ_ERROR_UNDEFINED_VAR; }
     static bool found_errors(int error);
-    
-    std::map<std::string, Ast_FuncDecleration*> functions;
-    std::map<std::string, Object> values; 
+private:
+    struct Frame {
+        uint32_t base;
+        uint32_t enclosing;
+    };
 
-    Environment* next = nullptr;
-    Environment* previous = nullptr;
+    std::vector<Object> slots;
+    std::vector<Frame> frames;
 };
 
-#endif // !ENVIRONMENT_H
\ No newline at end of file
+#endif // !ENVIRONMENT_H
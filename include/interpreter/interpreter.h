@@ -21,19 +21,30 @@ public:
     Interpreter() = default;
     ~Interpreter() = default;
 
+    // The unit has to have been resolved, see resolver.h, and can have been checked, see checker.h.
     void interpret(Ast_TranslationUnit* unit);
 
     static RunTimeError construct_runtime_error(Ast ast, const char* msg);
     static void         print_runtime_error(const RunTimeError& runtime_error);
+
+    // The operators on values, also used to work out constant expressions ahead of time.
+    static Object apply_unary(int op, Object value);
+    static Object apply_binary(int op, Object left, Object right);
+
+    // For expressions the checker gave a type, type is that of the operands, see checker.h.
+    static Object apply_typed_unary(int op, int type, const Object& value);
+    static Object apply_typed_binary(int op, int type, const Object& left, const Object& right);
+
+    static int convert_to_interpreter_type(int ast_type);
 private:
     void   execute(Ast_Decleration* decleration);
     void   scope(Ast_Decleration* decleration);
-    Object execute_function(Ast_FuncDecleration* function, Ast_FunctionCall* call);
+    Object execute_function(Ast_FuncDecleration* function, Ast_FunctionCall* call, bool checked);
 
     Object assignment(Ast_Assignment* assign);
     void   print_statement(Ast_PrintStatement* print);
     void   variable_decleration(Ast_VarDecleration* decleration);
-    void   function_decleration(Ast_FuncDecleration* func);
+    void   increment(Ast_Increment* increment);
 
     void if_statement(Ast_ConditionalStatement* conditional);
     bool conditional_statement(Ast_ConditionalStatement* conditional);
@@ -46,12 +57,16 @@ private:
     Object evaluate_binary(Ast_BinaryExpression* binary);
     Object evaluate_assignment(Ast_Assignment* assign);
     Object evaluate_equal(Ast_Assignment* assign);
-    Object evaluate_function_call(Ast_FunctionCall* call);
+    Object evaluate_function_call(Ast_FunctionCall* call, bool checked);
+    Object evaluate_inline(Ast_InlineCall* call);
+    Object evaluate_invariant(Ast_LoopInvariant* invariant);
+    Object evaluate_induction(Ast_Induction* induction);
+    Object evaluate_common(Ast_CommonExpression* common);
+    Object evaluate_flat(const Ast_FlatExpressions* flat, uint32_t index);
 
-    int convert_to_interpreter_type(int ast_type);
 private:
     Environment environment;
-    Environment* current_environment;
+    Ast_TranslationUnit* unit = nullptr;
 };
 
 #endif // !INTERPRETER_H
\ No newline at end of file
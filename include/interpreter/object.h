@@ -27,7 +27,8 @@ enum {
     OBJ_ERROR_WRONG_TYPE,
     OBJ_ERROR_WRONG_RET_TYPE,
     OBJ_ERROR_CONVERT,
-    OBJ_ERROR_REDEFINITION
+    OBJ_ERROR_REDEFINITION,
+    OBJ_ERROR_BAD_BODY
 };
 
 static std::map<int, const char*> OBJ_ERROR_MESSAGES = {
@@ -45,7 +46,8 @@ static std::map<int, const char*> OBJ_ERROR_MESSAGES = {
     { OBJ_ERROR_WRONG_TYPE, "Types do not match" },
     { OBJ_ERROR_WRONG_RET_TYPE, "Types do not match in return expression" },
     { OBJ_ERROR_CONVERT, "Unable to convert between types" },
-    { OBJ_ERROR_REDEFINITION, "redefinition of existing variable" }
+    { OBJ_ERROR_REDEFINITION, "redefinition of existing variable" },
+    { OBJ_ERROR_BAD_BODY, "Function body has errors" }
 };
 
 struct Object {
@@ -0,0 +1,66 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.h"
+#include "diagnostics.h"
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// Goes over the tree between parsing and running it and gives every variable a slot in the frame
+// of the function it is declared in, or of the program, and every use of a variable the address of
+// its slot along with its declaration, see Ast_Address. Calls are bound to the function they call
+// the same way.
+//
+// Names are looked up where they are written. A use sees the variables declared before it in its
+// scope and in the scopes around it. A function body sees every variable of the scopes around it,
+// since it only runs once they are set up, and a function can be called from anywhere in the scope
+// it is declared in. A name that is not found gets slot 0 of the program's frame, which is never
+// defined, so using it is an error when the program gets there, the way it always was.
+class Resolver {
+public:
+    Resolver(DiagnosticSink& diagnostics) : diagnostics(diagnostics) { }
+
+    void resolve(Ast_TranslationUnit* unit);
+
+    // Resolves the body of a function that the parser skipped, once it has been parsed.
+    void resolve_body(Ast_FuncDecleration* func);
+private:
+    struct Scope {
+        Scope* parent = nullptr;
+        uint32_t level = 0; // of the frame the scope is in, the program's frame is 0
+
+        std::unordered_map<SymbolId, Ast_VarDecleration*> variables; // the last declaration of each name
+        std::unordered_map<SymbolId, Ast_FuncDecleration*> functions;
+        std::vector<Ast_FuncDecleration*> bodies; // resolved when the scope ends
+    };
+
+    // The slots in use in the frame being resolved, and the most it has needed.
+    struct Frame {
+        uint32_t next = 0;
+        uint32_t size = 0;
+    };
+
+    void begin_scope(const Ast_List<Ast_Decleration*>& declerations, uint32_t level);
+    void end_scope();
+    void body(Ast_FuncDecleration* func, Scope* enclosing);
+    void declare(Ast_VarDecleration* var);
+
+    void decleration(Ast_Decleration* decleration);
+    void block(Ast_Scope* scope);
+    void expression(Ast_Expression* expression);
+    void call(Ast_FunctionCall* call);
+    Ast_Address address(SymbolId name);
+
+    DiagnosticSink& diagnostics;
+
+    // Scopes are kept until the resolver goes, a skipped body is resolved in the scope it was in.
+    std::deque<Scope> scopes;
+    std::unordered_map<Ast_FuncDecleration*, Scope*> skipped;
+
+    Scope* current = nullptr;
+    Frame frame;
+};
+
+#endif // !RESOLVER_H
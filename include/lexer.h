@@ -2,10 +2,20 @@
 #define LEXER_H
 
 #include "common.h"
+#include "source.h"
+#include "symbol.h"
+#include "diagnostics.h"
 
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+// Single character tokens use the character itself as their kind and everything else is
+// numbered from T_EOF up, so every kind fits in a byte.
+using TokenKind = uint8_t;
+
 namespace Tok {
     enum {
         T_COLON = ':',
@@ -34,7 +44,7 @@ namespace Tok {
         T_COMMA = ',', 
         T_QUOTE = '"',
 
-        T_EOF = 255,
+        T_EOF = 128,
 
         T_AND,
         T_OR,
@@ -78,75 +88,232 @@ namespace Tok {
         T_PRINT, //temp??
         T_INPUT, //temp??
 
-        T_DASH_ARROW
+        T_DASH_ARROW,
+        T_IMPORT
     };
 }
 
+// Location of an identifier or string constant inside the source buffer.
+struct TokenText {
+    uint32_t offset;
+    uint32_t length;
+};
+
+union TokenValue {
+    int int_const;
+    double float_const;
+    char char_const;
+    SymbolId symbol;
+    TokenText text;
+};
+
+// Whether a token of this kind carries a value, only literals and identifiers do.
+inline bool has_value(int type) {
+    return type == Tok::T_IDENTIFIER || type == Tok::T_STRING_CONST || type == Tok::T_INT_CONST ||
+           type == Tok::T_FLOAT_CONST || type == Tok::T_CHAR_CONST;
+}
+
 struct Token {
-    Token() { }
-    Token(int type, uint32_t line) : type(type), line(line) { }
-    ~Token() { }
+    Token() = default;
+    Token(int type, uint32_t line) : type((TokenKind) type), line(line) { }
 
-    int type = 0;
-    uint32_t line = 0;
+    TokenKind type;
+    uint32_t line;
 
     union {
+        TokenValue value;
         int int_const;
         double float_const;
         char char_const;
-        char* identifier;
-        char* string;
+        SymbolId symbol; // identifiers
+        TokenText text;  // string constants (without the quotes)
     };
 };
 
+// Leaves new elements uninitialized when the vector is resized. The parallel lexer sizes the
+// token list up front and the pages should first be touched by the threads filling them in.
+template <typename T>
+struct UninitializedAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind { using other = UninitializedAllocator<U>; };
+
+    UninitializedAllocator() = default;
+    template <typename U>
+    UninitializedAllocator(const UninitializedAllocator<U>&) { }
+
+    template <typename U>
+    void construct(U* p) { ::new ((void*) p) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new ((void*) p) U(std::forward<Args>(args)...); }
+};
+
+template <typename T>
+using UninitializedVector = std::vector<T, UninitializedAllocator<T>>;
+
+// The token list stored as parallel arrays. The parser mostly looks at kinds so those are packed
+// a byte each, and values are only kept for the tokens that have one, in the order they appear.
+// Because of that the tokens are read in order through a cursor rather than by index.
+class TokenStore {
+public:
+    struct Cursor {
+        uint32_t index = 0;
+        uint32_t value = 0;
+    };
+
+    inline size_t size() const { return kinds.size(); }
+    inline size_t value_count() const { return values.size(); }
+    inline TokenKind kind(size_t index) const { return kinds[index]; }
+    inline uint32_t line(size_t index) const { return lines[index]; }
+
+    void reserve(size_t count);
+    void push(const Token& token);
+    uint32_t count_values(uint32_t begin, uint32_t end) const;
+
+    // Returns the token under the cursor and moves past it, the last token is returned over and over.
+    inline Token read(Cursor& cursor) const {
+        Token token(kinds[cursor.index], lines[cursor.index]);
+        bool valued = has_value(token.type);
+        if (valued)
+            token.value = values[cursor.value];
+        if (cursor.index + 1 < kinds.size()) {
+            cursor.index++;
+            cursor.value += valued;
+        }
+        return token;
+    }
+
+    // Grows the store without initializing the new entries, they are then filled in with copy_from
+    // or set.
+    void resize(size_t count, size_t value_count);
+    void copy_from(const TokenStore& from, size_t index, size_t value_index, uint32_t line_offset);
+
+    // Puts the token at index, and its value at value_index which is then moved past it if the
+    // token has one. There has to be room for a value either way.
+    inline void set(size_t index, size_t& value_index, const Token& token) {
+        kinds[index] = token.type;
+        lines[index] = token.line;
+        values[value_index] = token.value;
+        value_index += has_value(token.type);
+    }
+
+    // Where each token starts on its line, and which values are string constants whose text moves
+    // with the source. Only kept by a lexer that takes edits, see Lexer::edit.
+    inline uint32_t column(size_t index) const { return columns[index]; }
+    inline void set_column(size_t index, uint32_t column) { columns[index] = column; }
+    void push(const Token& token, uint32_t column);
+    uint32_t first_on_line(uint32_t line) const;
+
+    void splice(Cursor at, Cursor removed, const TokenStore& with);
+    void shift(Cursor from, int32_t line_delta, int32_t offset_delta);
+private:
+    UninitializedVector<TokenKind> kinds;
+    UninitializedVector<uint32_t> lines;
+    UninitializedVector<TokenValue> values;
+    UninitializedVector<uint32_t> columns;
+    std::vector<uint32_t> strings;
+};
+
+// The tokens an edit of the source replaced, see Lexer::edit. The counts are kept as cursors,
+// index for the tokens and value for the values among them. Everything after the added tokens
+// is what came after the removed ones, moved down by lines lines.
+struct TokenEdit {
+    TokenStore::Cursor first;
+    TokenStore::Cursor removed;
+    TokenStore::Cursor added;
+    int32_t lines = 0;
+};
+
+struct LexerError {
+    uint32_t line;
+    const char* msg;
+};
+
 class Lexer {
 public:
     Lexer(const char* filepath);
-    void lex();
-    void log();
+    ~Lexer();
+    void  lex();
+    void  lex_parallel(uint32_t chunk_count);
+    void  lex_pipelined();
+    TokenEdit edit(uint32_t offset, uint32_t count, std::string_view text);
+    Token next();
+    void  rewind() { cursor = TokenStore::Cursor(); }
+    void  log();
     const char* file() { return filepath; }
 
     void        log_token(Token& token, uint32_t i);
-    static void print_token(Token& token);
+    void        print_token(Token& token);
     static void print_from_type(int type);
     static void log_keywords_symbols(int type);
 
-    std::vector<Token>* fetch_tokens() { return &tokens; }
+    TokenStore* fetch_tokens() { return &tokens; }
 
     inline uint32_t lines() const { return current_line; }
+    inline std::string_view text(const Token& token) const { return input->view(token.text.offset, token.text.length); }
 private:
+    Lexer(const Source* input, const char* filepath, uint32_t begin, uint32_t end, uint32_t nested_comment);
+
+    struct Pipeline;
+
     void load();
+    void lex_range();
+    void produce();
+    Token next_pipelined();
+    void lexer_error(uint32_t line, const char* msg);
 
-    void newline();
-    void multiline_comment_beg();
-    void multiline_comment_end();
-    void singleline_comment();
-    char incr_char(int32_t off = 1); //Get a character from a specifc offset, initally it is just 1.
-    bool is_identifier(char c);
-    bool is_spec_char(char c);
-    void remove_whitespaces(char* s);
+    Token scan();
+    Token scan_at(uint32_t index, uint32_t& start);
+    Token identifier();
+    Token numeric();
+    Token string_const();
+    Token char_const();
+    Token symbol();
+    void  singleline_comment();
+    void  multiline_comment();
 
-    void     create_sym_token();
-    void     move();
-    uint32_t get_type(char c);
-    void     reset();
+    static int find_keyword(std::string_view text);
+    static int find_symbol(char first, char second);
 
 public:
-    std::vector<Token> tokens;
+    TokenStore tokens;
+    TokenStore::Cursor cursor;
+    bool lexed = false;
+
     const char* filepath = nullptr;
 
-    std::string current;
+    Source source;
+    const Source* input = &source; // the lexers of a parallel lex share one source
 
-    uint32_t current_type = 0;
+    // The scanning state, everything needed to resume lexing from a point in the source.
     uint32_t current_index = 0;
-
-    std::string stream;
-    uint32_t size = 0;
-    
+    uint32_t end_index = 0;
+    uint32_t current_line = 1;
     uint32_t nested_comment = 0;
+    uint32_t token_start = 0;
 
-    uint32_t counter = 0;
-    uint32_t current_line = 1;
+    // Used when lexing a chunk of a parallel lex. A chunk that ends part way through a token 
+    // records where that token started so it can be lexed again with the following chunk.
+    static constexpr uint32_t NO_CUT = 0xFFFFFFFF;
+    uint32_t cut_index = NO_CUT;
+    bool defer_errors = false;
+    std::vector<LexerError> errors;
+
+    SymbolCache symbols;
+
+    // Where the errors go, the parser reports its own errors here as well.
+    DiagnosticSink diagnostics;
+
+    // Set before lex() for a lexer that takes edits. It then keeps where every line starts, so a
+    // token is found from its line and column, and for every error it reported the index of the 
+    // token it came before, in order.
+    bool editable = false;
+    std::vector<uint32_t> line_starts;
+    std::vector<uint32_t> error_tokens;
+
+    inline uint32_t token_offset(uint32_t index) const { return line_starts[tokens.line(index) - 1] + tokens.column(index); }
+
+    // Set while the tokens are coming from a lexer thread, see lex_pipelined.
+    std::unique_ptr<Pipeline> pipeline;
 };
 
 #endif // !LEXER_H
\ No newline at end of file
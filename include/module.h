@@ -0,0 +1,56 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One file of a program. A file imported from more than one place is one module.
+struct Module {
+    std::string path; // what the lexer reads and errors name, the importing directory joined with the import
+    std::string key;  // the full path with links followed, which tells two imports of the same file apart
+
+    Lexer* lexer = nullptr;
+    Ast_TranslationUnit* unit = nullptr;
+    std::vector<Module*> imports;
+    uint32_t index = 0; // in the order the modules were found, the program is 0
+    bool from_cache = false;
+
+    // The lexer, parser and tree of every module but the first are kept here.
+    std::unique_ptr<Lexer> own_lexer;
+    std::unique_ptr<Parser> parser;
+    std::unique_ptr<Ast_TranslationUnit> cached;
+};
+
+// The files of a program and what they import. The program file is parsed first, then every file
+// it imports, then every file those import, and so on. The files of each round do not depend on
+// each other and are lexed and parsed together on the thread pool, or read from the cache when
+// one is given, so after a change only the changed files are parsed again.
+class ModuleGraph {
+public:
+    ModuleGraph(Lexer& lexer, Ast_TranslationUnit* unit, const char* cache_dir = nullptr);
+
+    // Loads everything the program imports and links it into the program's unit, see link.
+    // The errors of each module are written out in the order the modules were found.
+    void load();
+
+    inline uint32_t imported() const { return (uint32_t) modules.size() - 1; }
+    inline uint32_t from_cache() const { return cached; }
+private:
+    void parse(Module* module);
+    Module* find(Module* importer, Ast_ImportDecleration* import);
+    void order(Module* module, std::vector<Module*>& ordered, std::vector<uint8_t>& visited);
+    void link();
+
+    std::vector<std::unique_ptr<Module>> modules;
+    std::unordered_map<std::string, Module*> by_key;
+    const char* cache_dir = nullptr;
+    uint32_t cached = 0;
+};
+
+#endif // !MODULE_H
@@ -0,0 +1,45 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "ast.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// What a piece of code can write, by the declarations of the variables.
+struct Effects {
+    std::unordered_set<Ast_VarDecleration*> written;
+    std::unordered_set<Ast_VarDecleration*> incremented; // only ever by an Ast_Increment
+    bool anything = false;                               // calls a function whose body was not parsed
+
+    inline bool writes(Ast_VarDecleration* var) const {
+        return anything || written.count(var) > 0 || incremented.count(var) > 0;
+    }
+};
+
+// Works out what while loops can write, for the passes that move work out of them. A loop writes
+// every variable it assigns, increments or declares, and everything the functions it calls can
+// write, found by following the calls in their bodies.
+class EffectAnalysis {
+public:
+    Effects loop(Ast_WhileLoop* loop);
+private:
+    // What a piece of code does itself, without what the functions it calls do.
+    struct Direct {
+        Effects effects;
+        std::vector<Ast_FuncDecleration*> called;
+    };
+
+    void direct(Ast_Decleration* decleration, Direct& direct);
+    void direct(Ast_Expression* expression, Direct& direct);
+    const Direct& body(Ast_FuncDecleration* func);
+
+    std::unordered_map<Ast_FuncDecleration*, Direct> bodies;
+};
+
+// An expression is invariant in a loop when it reads nothing the loop can write and has no effect
+// of its own, so no calls, input or assignments.
+bool is_invariant(Ast_Expression* expression, const Effects& loop);
+
+#endif // !EFFECTS_H
@@ -0,0 +1,65 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+
+#include <vector>
+
+// A change a pass made at a place in the source, listed by -opt-stats.
+struct OptimizeNote {
+    const char* what;
+    const char* file;
+    uint32_t line;
+};
+
+struct OptimizeStats {
+    uint32_t folded = 0;      // operators and casts of constants worked out ahead of time
+    uint32_t propagated = 0;  // uses of constant variables replaced by their values
+    uint32_t inlined = 0;     // calls replaced by the body of the function
+    uint32_t hoisted = 0;     // expressions of loops worked out once each time the loop runs
+    uint32_t incremented = 0; // assignments that add a literal turned into increments
+    uint32_t reduced = 0;     // products of loop counters kept up to date by their increments
+    uint32_t shared = 0;      // repeated expressions replaced by the value worked out before them
+    uint32_t eliminated = 0;  // nodes taken out of the tree because they can never run
+
+    // What the inliner, the loop passes and the common subexpression pass did where, in that order.
+    std::vector<OptimizeNote> notes;
+
+    inline void note(const char* what, const Ast& at) { notes.push_back({ what, at.file(), at.source_line() }); }
+};
+
+struct OptimizeOptions {
+    uint32_t inline_size = 16; // the most nodes a returned expression can have to be inlined, 0 inlines nothing
+};
+
+// Rewrites the tree of a translation unit into one that does the same with less work. The unit
+// has to have been resolved and checked, only expressions the checker gave a type are changed.
+// A program that would stop with an error still stops there with the same error.
+OptimizeStats optimize_translation_unit(Ast_TranslationUnit* unit, const OptimizeOptions& options = OptimizeOptions());
+
+// The passes, in the order they are first run.
+
+// Works out operators and casts whose operands are literals, and puts the value of a constant
+// variable with a literal value in place of its uses, see fold.cpp.
+void fold_constants(Ast_TranslationUnit* unit, OptimizeStats& stats);
+
+// Takes out branches whose literal condition never lets them run, statements after a return or a
+// loop that never ends, and functions that are never called, see dead.cpp.
+void eliminate_dead_code(Ast_TranslationUnit* unit, OptimizeStats& stats);
+
+// Puts the body of a function that only returns a small expression in place of the calls to it,
+// see inline.cpp.
+void inline_functions(Ast_TranslationUnit* unit, uint32_t size, OptimizeStats& stats);
+
+// Keeps the value of the expressions of a while loop that do not change while it runs, see hoist.cpp.
+void hoist_loop_invariants(Ast_TranslationUnit* unit, OptimizeStats& stats);
+
+// Adds literals to variables in place, and keeps the products of a loop's counters with values
+// that do not change in it up to date as the counters move, see induction.cpp.
+void reduce_induction_variables(Ast_TranslationUnit* unit, OptimizeStats& stats);
+
+// Works out an expression repeated in a straight run of statements once and reuses the value until
+// one of its variables is written, see common.cpp.
+void eliminate_common_subexpressions(Ast_TranslationUnit* unit, OptimizeStats& stats);
+
+#endif // !OPTIMIZER_H
@@ -0,0 +1,33 @@
+#ifndef WALKER_H
+#define WALKER_H
+
+#include "ast.h"
+
+// Goes over the code of a translation unit for the optimizer passes. A pass overrides the cases it
+// changes and calls walk for the rest, which goes on to the parts under the node. Statements and
+// expressions are taken by reference so a pass can put another node in their place.
+//
+// The body of an inlined call is left out, it is the function's code in terms of its parameters.
+class Walker {
+public:
+    Walker(Ast_TranslationUnit* unit) : unit(unit) { }
+    virtual ~Walker() { }
+
+    void program(Ast_List<Ast_Decleration*>& declerations);
+protected:
+    virtual void block(Ast_List<Ast_Decleration*>& declerations);
+    virtual void decleration(Ast_Decleration*& decleration) { walk(decleration); }
+    virtual void expression(Ast_Expression*& expression) { walk(expression); }
+    virtual void function(Ast_FuncDecleration* func);
+
+    void walk(Ast_Decleration*& decleration);
+    void walk(Ast_Expression*& expression);
+
+    Ast_TranslationUnit* unit;
+
+    // The frame the code being gone over runs in, the unit's or a function's. A pass that keeps
+    // values for the code adds its slots at the end of it.
+    uint32_t* frame_size = nullptr;
+};
+
+#endif // !WALKER_H
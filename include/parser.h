@@ -6,13 +6,7 @@
 #include "ast.h"
 
 #include <map>
-
-struct ParserError {
-    Token* token = nullptr;
-
-    ParserError() = default;
-    ParserError(Token* token) : token(token) { }
-};
+#include <vector>
 
 class Parser {
 public:
@@ -21,11 +15,30 @@ public:
     ~Parser();
 
     void parse();
+    void parse_parallel(uint32_t partition_count);
+
+    // Skips over function bodies while parsing and parses each one on the first call to it, see
+    // parse_body. Needs the whole token list, so it is only turned on once the lexer has lexed.
+    void set_lazy_functions(bool lazy) { this->lazy = lazy && lexer->lexed && !incremental; }
+    Ast_Scope* parse_body(Ast_FuncDecleration* func);
+    inline uint32_t skipped_bodies() const { return skipped; }
+
+    // Parses the top level declarations one run of tokens at a time and remembers the runs, so
+    // after an edit only the runs it touched are parsed again, see reparse. Needs a lexer that
+    // takes edits and has lexed. Function bodies are not skipped in this mode.
+    void set_incremental(bool incremental) {
+        this->incremental = incremental && lexer->editable && lexer->lexed;
+        lazy = lazy && !this->incremental;
+    }
+    uint32_t reparse(const TokenEdit& edit);
+
+    // The errors in the program as it is now, of the tokens that are there and the runs as they were last parsed.
+    inline size_t current_errors() const { return run_errors + lexer->error_tokens.size(); }
 
     Token* peek(int index = 0);
     Token* advance();
 
-    ParserError parser_error(Token* token, const char* msg);
+    std::nullptr_t parser_error(Token* token, const char* msg);
     Token* consume(int type, const char* msg);
     bool match(int type);
     bool check(int type);
@@ -34,13 +47,7 @@ public:
     Ast_TranslationUnit* translation_unit() { return root; }
 private:
     Ast_Expression* expression();
-    Ast_Expression* logical();
-    Ast_Expression* equality();
-    Ast_Expression* bitwise();
-    Ast_Expression* comparison();
-    Ast_Expression* shifts();
-    Ast_Expression* term();
-    Ast_Expression* factor();
+    Ast_Expression* binary(uint8_t min_power);
     Ast_Expression* unary();
     Ast_Expression* primary();
 
@@ -49,10 +56,13 @@ private:
     Ast_Expression*           assignment();
     Ast_VarDecleration*       var_decleration(bool semi = true);
     Ast_FuncDecleration*      func_decleration();
-    std::vector<Ast_VarDecleration*> func_args();
+    Ast_ImportDecleration*    import_decleration();
+    bool                      func_args(Ast_List<Ast_VarDecleration*>& args);
     Ast_Decleration*          decleration();
     Ast_Statement*            statement(); 
     Ast_Scope*                scope();
+    Ast_Scope*                body();
+    bool                      skip_scope();
 
     Ast_ReturnStatement*      return_statement();
     Ast_ConditionalStatement* conditional_statement();
@@ -62,17 +72,59 @@ private:
     Ast_WhileLoop*            while_loop();
 
     Ast* default_ast(Ast* ast);
+    void begin_origin();
+
+    Parser(Lexer* lexer, TokenStore::Cursor begin, uint32_t end);
 
-    void synchronize();
-    int token_to_ast(Token* token);
+    void  parse_declerations();
+    void  parse_runs();
+    Token pull(uint32_t slot);
+    void  prime();
+    void  synchronize();
     int token_to_ast_unary(Token* token);
     int token_to_equal(Token* token);
     int type();
+    const char* string_const(Token* token);
 private:
-    std::vector<Token> tokens;
+    // Tokens are pulled from the lexer as the parser goes. The window holds the previous
+    // token, the current one and enough lookahead for peek(2), indexed by current.
+    static constexpr int TOKEN_WINDOW = 4;
+
+    Lexer* lexer = nullptr;
+
+    // Where the next token is read from. This is the lexer's own cursor, except for a parser 
+    // given one part of a parallel parse which reads the lexer's token store up to end by itself.
+    TokenStore::Cursor* cursor = nullptr;
+    TokenStore::Cursor partition_cursor;
+    uint32_t end = UINT32_MAX;
+
+    DiagnosticSink* diagnostics = nullptr;
+    DiagnosticSink partition_diagnostics;
+
+    Token window[TOKEN_WINDOW] = { };
+    TokenStore::Cursor positions[TOKEN_WINDOW]; // where each token in the window was read from
     uint32_t current = 0;
+    uint32_t scope_depth = 0;
+    bool lazy = false;
+    uint32_t skipped = 0;
+
+    // A run is the tokens of one top level declaration as partition_declerations splits them, 
+    // it ends where the next one begins. It can hold more or less than one declaration when
+    // it has errors.
+    struct Run {
+        TokenStore::Cursor begin;
+        uint32_t declerations = 0;
+        uint32_t errors = 0;
+    };
+
+    Run parse_run(TokenStore::Cursor begin, uint32_t end, std::vector<Ast_Decleration*>& declerations);
+
+    bool incremental = false;
+    std::vector<Run> runs;
+    size_t run_errors = 0;
     Ast_TranslationUnit* root = nullptr;
     const char* filepath = nullptr;
+    Ast_Origin* origin = nullptr; // of the top level declaration being parsed
 };
 
 #endif // !PARSER_H
\ No newline at end of file
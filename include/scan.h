@@ -0,0 +1,29 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "common.h"
+
+// Bulk scanning routines used by the lexer to skip over whitespace, comments and string bodies,
+// and to count through the token kinds when the tokens are edited.
+// Each one looks at 16 or 32 bytes at a time with SSE2 or AVX2, picked once at startup from
+// what the CPU supports, and falls back to a plain loop everywhere else.
+// None of them read at or past end.
+
+// Returns the index of the first character in [index, end) that is not whitespace, or end.
+// The newlines skipped over are added to lines.
+uint32_t skip_whitespace(const char* data, uint32_t index, uint32_t end, uint32_t& lines);
+
+// Returns the index of the first occurrence of c in [index, end), or end.
+uint32_t find_byte(const char* data, uint32_t index, uint32_t end, char c);
+
+// Returns the index of the first occurrence of a or b in [index, end), or end.
+// The newlines before it are added to lines.
+uint32_t find_either(const char* data, uint32_t index, uint32_t end, char a, char b, uint32_t& lines);
+
+// Returns how many bytes in [index, end) are one of the count bytes of set, at most 8 of them.
+uint32_t count_any(const char* data, uint32_t index, uint32_t end, const char* set, uint32_t count);
+
+// The name of the instruction set the routines above are using.
+const char* scan_isa();
+
+#endif // !SCAN_H
@@ -0,0 +1,42 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include "common.h"
+
+#include <string>
+#include <string_view>
+
+// A read-only source buffer backed by a memory mapping of the file. Tokens and
+// the ast refer into it by offset, so it has to outlive everything that was lexed
+// from it. A source that is edited (see replace) keeps a copy of the text instead.
+class Source {
+public:
+    Source() = default;
+    Source(const char* filepath);
+    ~Source();
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+    bool open(const char* filepath);
+    void close();
+    void replace(uint32_t offset, uint32_t count, std::string_view text);
+
+    inline const char* data() const { return buffer; }
+    inline uint32_t size() const { return length; }
+
+    inline char at(uint32_t index) const { return (index < length) ? buffer[index] : '\0'; }
+    inline std::string_view view(uint32_t offset, uint32_t count) const { return std::string_view(buffer + offset, count); }
+private:
+    const char* buffer = "";
+    uint32_t length = 0;
+    bool mapped = false;
+    std::string edited;
+
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+#endif // !SOURCE_H
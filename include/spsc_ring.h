@@ -0,0 +1,46 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "common.h"
+
+#include <atomic>
+
+// A bounded lock free queue for exactly one producer thread and one consumer thread. The slots
+// are filled and read in place: the producer asks for the next free slot, fills it and publishes
+// it, the consumer looks at the oldest published slot and hands it back once it is done with it.
+template <typename T, uint32_t CAPACITY>
+class SpscRing {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "the capacity of a ring has to be a power of two");
+public:
+    // Producer side, returns nullptr while the ring is full.
+    T* reserve() {
+        uint32_t at = tail.load(std::memory_order_relaxed);
+        if (at - head.load(std::memory_order_acquire) == CAPACITY)
+            return nullptr;
+        return &slots[at & (CAPACITY - 1)];
+    }
+
+    void publish() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side, returns nullptr while the ring is empty.
+    T* front() {
+        uint32_t at = head.load(std::memory_order_relaxed);
+        if (at == tail.load(std::memory_order_acquire))
+            return nullptr;
+        return &slots[at & (CAPACITY - 1)];
+    }
+
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+private:
+    T slots[CAPACITY];
+
+    // Kept on separate cache lines so the two threads do not keep stealing the line from each other.
+    alignas(64) std::atomic<uint32_t> head { 0 };
+    alignas(64) std::atomic<uint32_t> tail { 0 };
+};
+
+#endif // !SPSC_RING_H
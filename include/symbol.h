@@ -0,0 +1,42 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include "common.h"
+
+#include <string_view>
+
+// Identifiers are interned once by the lexer and from then on are only passed around
+// as dense ids, so comparing two names is comparing two integers.
+using SymbolId = uint32_t;
+
+constexpr SymbolId SYMBOL_NONE = 0xFFFFFFFF;
+
+SymbolId intern(std::string_view name);
+
+// The names are hashed with FNV-1a, a character at a time so the lexer can do it while it reads one.
+constexpr uint32_t SYMBOL_HASH_BASIS = 2166136261u;
+
+inline uint32_t hash_symbol(uint32_t hash, char c) {
+    return (hash ^ (uint8_t) c) * 16777619u;
+}
+
+std::string_view symbol_name(SymbolId symbol);
+
+uint32_t symbol_count();
+
+// A small direct mapped cache in front of intern() owned by one lexer. Most identifiers repeat,
+// so this keeps lexers that run at the same time from fighting over the shared table.
+class SymbolCache {
+public:
+    SymbolId intern(std::string_view name, uint32_t hash);
+private:
+    struct Entry {
+        std::string_view name;
+        SymbolId symbol = SYMBOL_NONE;
+    };
+
+    static constexpr uint32_t SIZE = 1024;
+    Entry entries[SIZE];
+};
+
+#endif // !SYMBOL_H
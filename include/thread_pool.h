@@ -0,0 +1,48 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "common.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run queued jobs. Used by the front end to lex and
+// parse pieces of a program at the same time.
+class ThreadPool {
+public:
+    ThreadPool(uint32_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+    void wait();
+
+    // Runs job(0) ... job(count - 1) on the pool and returns once they are all done.
+    void parallel_for(uint32_t count, const std::function<void(uint32_t)>& job);
+
+    inline uint32_t size() const { return (uint32_t) workers.size(); }
+
+    static uint32_t hardware_threads();
+private:
+    void work();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+
+    std::mutex lock;
+    std::condition_variable job_ready;
+    std::condition_variable jobs_done;
+    uint32_t running = 0;
+    bool stopping = false;
+};
+
+// The pool shared by the whole process, created with one thread per core on first use.
+ThreadPool& thread_pool();
+
+#endif // !THREAD_POOL_H
@@ -0,0 +1,81 @@
+/**
+ * @file arena.cpp
+ * @author strah19
+ * @date July 13 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * A bump pointer allocator used to hold the syntax tree of a translation unit.
+ */
+
+#include "arena.h"
+#include "err.h"
+
+Arena::~Arena() {
+    while (blocks) {
+        Block* next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+}
+
+/**
+ * Hands out size bytes aligned to align (a power of two). A request that does not fit in
+ * what is left of the current block starts a new one, big requests get a block of their own.
+ */
+void* Arena::allocate(size_t size, size_t align) {
+    uintptr_t at = ((uintptr_t) cursor + (align - 1)) & ~(uintptr_t) (align - 1);
+    if (!cursor || at + size > (uintptr_t) limit) {
+        size_t block_size = sizeof(Block) + align + size;
+        if (block_size < BLOCK_SIZE)
+            block_size = BLOCK_SIZE;
+
+        Block* block = (Block*) malloc(block_size);
+        if (!block)
+            fatal_error("Out of memory for the syntax tree.\n");
+        block->next = blocks;
+        blocks = block;
+
+        cursor = (char*) (block + 1);
+        limit = (char*) block + block_size;
+        at = ((uintptr_t) cursor + (align - 1)) & ~(uintptr_t) (align - 1);
+    }
+
+    cursor = (char*) (at + size);
+    bytes_used += size;
+    return (void*) at;
+}
+
+/**
+ * Takes over the blocks of other, which is left empty, so what was made in it lives as long as 
+ * this arena does. Allocation carries on in the current block.
+ */
+void Arena::adopt(Arena& other) {
+    if (!other.blocks)
+        return;
+
+    if (!blocks) {
+        blocks = other.blocks;
+        cursor = other.cursor;
+        limit = other.limit;
+    }
+    else {
+        Block* last = other.blocks;
+        while (last->next)
+            last = last->next;
+        last->next = blocks->next;
+        blocks->next = other.blocks;
+    }
+    bytes_used += other.bytes_used;
+
+    other.blocks = nullptr;
+    other.cursor = other.limit = nullptr;
+    other.bytes_used = 0;
+}
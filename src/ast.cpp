@@ -15,4 +15,104 @@
  * Mostly destructors for the Ast objects.
  */
 
-#include "ast.h"
\ No newline at end of file
+#include "ast.h"
+
+bool is_ast_literal(Ast_Expression* expression) {
+    if (!expression || expression->type != AST_PRIMARY)
+        return false;
+    int type = AST_CAST(Ast_PrimaryExpression, expression)->type_value;
+    return type == AST_INT || type == AST_FLOAT || type == AST_CHAR || type == AST_BOOLEAN || type == AST_STRING;
+}
+
+uint32_t count_ast_nodes(Ast_Decleration* ast) {
+    if (!ast)
+        return 0;
+
+    uint32_t count = 1;
+    switch (ast->type) {
+    case AST_EXPRESSION_STATEMENT:
+        count += count_ast_nodes(AST_CAST(Ast_ExpressionStatement, ast)->expression);
+        break;
+    case AST_PRINT:
+        for (auto printed : AST_CAST(Ast_PrintStatement, ast)->expressions)
+            count += count_ast_nodes(printed);
+        break;
+    case AST_SCOPE:
+        for (auto inner : AST_CAST(Ast_Scope, ast)->declerations)
+            count += count_ast_nodes(inner);
+        break;
+    case AST_VAR_DECLERATION:
+        count += count_ast_nodes(AST_CAST(Ast_VarDecleration, ast)->expression);
+        break;
+    case AST_FUNC_DECLERATION: {
+        auto func = AST_CAST(Ast_FuncDecleration, ast);
+        for (auto arg : func->args)
+            count += count_ast_nodes(arg);
+        count += count_ast_nodes(func->scope);
+        break;
+    }
+    case AST_RETURN:
+        count += count_ast_nodes(AST_CAST(Ast_ReturnStatement, ast)->expression);
+        break;
+    case AST_IF:
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE: {
+        auto conditional = AST_CAST(Ast_ConditionalStatement, ast);
+        count += count_ast_nodes(conditional->condition);
+        count += count_ast_nodes(conditional->scope);
+        count += count_ast_nodes(conditional->next);
+        break;
+    }
+    }
+    return count;
+}
+
+uint32_t count_ast_nodes(Ast_Expression* expression) {
+    if (!expression)
+        return 0;
+
+    uint32_t count = 1;
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_NESTED)
+            count += count_ast_nodes(primary->nested);
+        else if (primary->type_value == AST_CAST)
+            count += count_ast_nodes(primary->cast.expression);
+        else if (primary->type_value == AST_FUNC_CALL) {
+            for (auto arg : primary->call->args)
+                count += count_ast_nodes(arg);
+        }
+        break;
+    }
+    case AST_UNARY:
+        count += count_ast_nodes(AST_CAST(Ast_UnaryExpression, expression)->next);
+        break;
+    case AST_BINARY:
+        count += count_ast_nodes(AST_CAST(Ast_BinaryExpression, expression)->left);
+        count += count_ast_nodes(AST_CAST(Ast_BinaryExpression, expression)->right);
+        break;
+    case AST_ASSIGNMENT:
+        count += count_ast_nodes(AST_CAST(Ast_Assignment, expression)->expression);
+        break;
+    case AST_INLINE: {
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        for (auto arg : inlined->args)
+            count += count_ast_nodes(arg);
+        count += count_ast_nodes(inlined->body);
+        break;
+    }
+    case AST_INVARIANT:
+        count += count_ast_nodes(AST_CAST(Ast_LoopInvariant, expression)->expression);
+        break;
+    case AST_COMMON:
+        count += count_ast_nodes(AST_CAST(Ast_CommonExpression, expression)->expression);
+        break;
+    case AST_INDUCTION:
+        count += count_ast_nodes(AST_CAST(Ast_Induction, expression)->left);
+        count += count_ast_nodes(AST_CAST(Ast_Induction, expression)->right);
+        break;
+    }
+    return count;
+}
@@ -16,10 +16,11 @@
  * parts of the compiler.
  */
 
-#include <time.h>
 #include <stdio.h>
+#include <chrono>
 
-static clock_t bench_clock;
+// Wall clock time, the parallel parts of the front end would be over counted by cpu time.
+static std::chrono::steady_clock::time_point bench_clock;
 
 /**
  * 
@@ -27,7 +28,7 @@ static clock_t bench_clock;
  * 
  */
 void begin_debug_benchmark() {
-    bench_clock = clock();
+    bench_clock = std::chrono::steady_clock::now();
 }
 
 /**
@@ -36,9 +37,14 @@ void begin_debug_benchmark() {
  * 
  */
 float end_debug_benchmark(const char* label) {
-    clock_t end = clock();
-    double time_spent = (double)(end - bench_clock);
+    auto end = std::chrono::steady_clock::now();
+    double time_spent = std::chrono::duration<double, std::milli>(end - bench_clock).count();
     printf("Benchmark time for %s is %f ms.\n", label, time_spent);
 
     return (float) time_spent;
-}
\ No newline at end of file
+}
+// The time since begin_debug_benchmark in ms without printing it, for timing many short steps.
+float debug_benchmark_time() {
+    auto end = std::chrono::steady_clock::now();
+    return (float) std::chrono::duration<double, std::milli>(end - bench_clock).count();
+}
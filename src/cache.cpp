@@ -0,0 +1,662 @@
+/**
+ * @file cache.cpp
+ * @author strah19
+ * @date July 16 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Writes parsed programs to .yaplc files and reads them back.
+ */
+
+#include "cache.h"
+#include "config.h"
+#include "source.h"
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Bumped whenever the layout of a .yaplc file changes.
+static constexpr uint32_t CACHE_FORMAT = 3;
+static constexpr char CACHE_MAGIC[4] = { 'Y', 'P', 'L', 'C' };
+
+// Written in front of null pointers, no node has this type.
+static constexpr uint8_t NODE_NULL = 0xFF;
+
+struct CacheHeader {
+    char     magic[4];
+    uint32_t format;
+    uint32_t version_major;
+    uint32_t version_minor;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint64_t payload_hash;
+    uint64_t payload_size;
+};
+
+// FNV-1a taken a word at a time, with the high half folded back down after each step since a
+// multiply only carries bits upwards. Hashing the source and the payload is most of a cache hit.
+static uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull) {
+    const uint64_t PRIME = 0x100000001B3ull;
+    const uint8_t* bytes = (const uint8_t*) data;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * PRIME;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * PRIME;
+    return hash;
+}
+
+// The key of a source, it changes with the source, the YAPL version and the cache format.
+static uint64_t source_hash(const Source& source) {
+    uint32_t versions[3] = { YAPL_VERSION_MAJOR, YAPL_VERSION_MINOR, CACHE_FORMAT };
+    return hash_bytes(source.data(), source.size(), hash_bytes(versions, sizeof(versions)));
+}
+
+static std::string cache_path(const char* dir, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.yaplc", (unsigned long long) hash);
+    return std::string(dir) + "/" + name;
+}
+
+/**
+ * Writes the tree out node by node, each node as its type, its line and then its fields in a
+ * fixed order. Every top level declaration starts with the line of its origin, the lines of the
+ * nodes under it are counted from there like the parser keeps them. Symbols are written as indices into a table of names written ahead of the nodes,
+ * since the ids are only good for this run.
+ */
+class CacheWriter {
+public:
+    bool write(Ast_TranslationUnit* unit, std::string& payload);
+private:
+    void u8(uint8_t value) { nodes.push_back((char) value); }
+    void u32(uint32_t value) { nodes.append((const char*) &value, sizeof(value)); }
+    void bytes(const char* data, uint32_t size) { u32(size); nodes.append(data, size); }
+    void symbol(SymbolId symbol);
+
+    void expression(Ast_Expression* expression);
+    void primary(Ast_PrimaryExpression* primary);
+    void decleration(Ast_Decleration* decleration);
+    void conditional(Ast_ConditionalStatement* conditional);
+
+    std::string nodes;
+    std::unordered_map<SymbolId, uint32_t> symbol_indices;
+    std::vector<SymbolId> symbols;
+    bool ok = true;
+};
+
+bool CacheWriter::write(Ast_TranslationUnit* unit, std::string& payload) {
+    u32(unit->declerations.size());
+    for (auto decleration : unit->declerations) {
+        u32(decleration->origin->line);
+        this->decleration(decleration);
+    }
+    if (!ok)
+        return false;
+
+    uint32_t count = (uint32_t) symbols.size();
+    payload.append((const char*) &count, sizeof(count));
+    for (auto symbol : symbols) {
+        std::string_view name = symbol_name(symbol);
+        uint32_t size = (uint32_t) name.size();
+        payload.append((const char*) &size, sizeof(size));
+        payload.append(name.data(), size);
+    }
+    payload += nodes;
+    return true;
+}
+
+void CacheWriter::symbol(SymbolId symbol) {
+    auto found = symbol_indices.find(symbol);
+    if (found == symbol_indices.end()) {
+        found = symbol_indices.emplace(symbol, (uint32_t) symbols.size()).first;
+        symbols.push_back(symbol);
+    }
+    u32(found->second);
+}
+
+void CacheWriter::expression(Ast_Expression* expression) {
+    if (!expression) {
+        u8(NODE_NULL);
+        return;
+    }
+
+    u8((uint8_t) expression->type);
+    u32(expression->line);
+    switch (expression->type) {
+    case AST_PRIMARY:
+        primary(AST_CAST(Ast_PrimaryExpression, expression));
+        break;
+    case AST_UNARY: {
+        auto unary = AST_CAST(Ast_UnaryExpression, expression);
+        u32(unary->op);
+        this->expression(unary->next);
+        break;
+    }
+    case AST_BINARY: {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        u32(binary->op);
+        this->expression(binary->left);
+        this->expression(binary->right);
+        break;
+    }
+    case AST_ASSIGNMENT: {
+        auto assign = AST_CAST(Ast_Assignment, expression);
+        u32(assign->equal_type);
+        symbol(assign->id);
+        this->expression(assign->expression);
+        break;
+    }
+    default:
+        ok = false;
+    }
+}
+
+void CacheWriter::primary(Ast_PrimaryExpression* primary) {
+    u32(primary->type_value);
+    u32((uint32_t) primary->array_size);
+    switch (primary->type_value) {
+    case AST_FLOAT: {
+        uint32_t bits;
+        memcpy(&bits, &primary->float_const, sizeof(bits));
+        u32(bits);
+        break;
+    }
+    case AST_INT:     u32((uint32_t) primary->int_const); break;
+    case AST_BOOLEAN: u8(primary->boolean); break;
+    case AST_CHAR:    u8((uint8_t) primary->char_const); break;
+    case AST_INPUT:   u32(primary->input_type); break;
+    case AST_ID:      symbol(primary->ident); break;
+    case AST_STRING:  bytes(primary->string, (uint32_t) strlen(primary->string)); break;
+    case AST_NESTED:  expression(primary->nested); break;
+    case AST_CAST:
+        u32(primary->cast.cast_type);
+        expression(primary->cast.expression);
+        break;
+    case AST_FUNC_CALL:
+        symbol(primary->call->ident);
+        u32(primary->call->args.size());
+        for (auto arg : primary->call->args)
+            expression(arg);
+        break;
+    default:
+        ok = false;
+    }
+}
+
+void CacheWriter::decleration(Ast_Decleration* decleration) {
+    if (!decleration) {
+        u8(NODE_NULL);
+        return;
+    }
+
+    switch (decleration->type) {
+    case AST_IF:
+    case AST_WHILE:
+        conditional(AST_CAST(Ast_ConditionalStatement, decleration));
+        return;
+    }
+
+    u8((uint8_t) decleration->type);
+    u32(decleration->line);
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        expression(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+        break;
+    case AST_PRINT: {
+        auto print = AST_CAST(Ast_PrintStatement, decleration);
+        u32(print->expressions.size());
+        for (auto printed : print->expressions)
+            expression(printed);
+        break;
+    }
+    case AST_SCOPE: {
+        auto scope = AST_CAST(Ast_Scope, decleration);
+        u32(scope->declerations.size());
+        for (auto inner : scope->declerations)
+            this->decleration(inner);
+        break;
+    }
+    case AST_VAR_DECLERATION: {
+        auto var = AST_CAST(Ast_VarDecleration, decleration);
+        u32(var->type_value);
+        u32(var->specifiers);
+        symbol(var->ident);
+        expression(var->expression);
+        break;
+    }
+    case AST_FUNC_DECLERATION: {
+        auto func = AST_CAST(Ast_FuncDecleration, decleration);
+        if (!func->scope) {
+            ok = false;
+            break;
+        }
+        symbol(func->ident);
+        u32(func->return_type);
+        u32(func->args.size());
+        for (auto arg : func->args)
+            this->decleration(arg);
+        this->decleration(func->scope);
+        break;
+    }
+    case AST_RETURN:
+        expression(AST_CAST(Ast_ReturnStatement, decleration)->expression);
+        break;
+    case AST_IMPORT: {
+        const char* path = AST_CAST(Ast_ImportDecleration, decleration)->path;
+        bytes(path, (uint32_t) strlen(path));
+        break;
+    }
+    default:
+        ok = false;
+    }
+}
+
+// An if or while with the elifs and else chained after it.
+void CacheWriter::conditional(Ast_ConditionalStatement* conditional) {
+    if (!conditional) {
+        u8(NODE_NULL);
+        return;
+    }
+
+    u8((uint8_t) conditional->type);
+    u32(conditional->line);
+    expression(conditional->condition);
+    decleration(conditional->scope);
+    this->conditional(conditional->next);
+}
+
+/**
+ * Reads a tree written by CacheWriter back into the arena of a new translation unit. Everything
+ * read is checked against the end of the file, a file that does not hold what was expected makes
+ * the read fail rather than the program crash.
+ */
+class CacheReader {
+public:
+    CacheReader(const char* data, size_t size, Ast_TranslationUnit* unit, const char* file) :
+        at((const uint8_t*) data), end((const uint8_t*) data + size), unit(unit), file(file) { }
+
+    bool read();
+private:
+    uint8_t u8();
+    uint32_t u32();
+    SymbolId symbol();
+    uint32_t count();
+    const char* string();
+
+    template <typename T>
+    T* node(uint32_t line) {
+        T* made = unit->arena.make<T>();
+        made->line = line;
+        made->origin = origin;
+        return made;
+    }
+
+    template <typename T>
+    T* list(Ast_List<T>& list, uint32_t size) {
+        list.items = unit->arena.make_array<T>(size);
+        list.count = list.capacity = size;
+        return list.items;
+    }
+
+    Ast_Expression* expression();
+    bool primary(Ast_PrimaryExpression* primary);
+    Ast_Decleration* decleration();
+    Ast_Scope* scope();
+    Ast_ConditionalStatement* conditional(uint8_t type);
+
+    const uint8_t* at;
+    const uint8_t* end;
+    Ast_TranslationUnit* unit;
+    const char* file;
+    Ast_Origin* origin = nullptr; // of the top level declaration being read
+    std::vector<SymbolId> symbols;
+    bool ok = true;
+};
+
+uint8_t CacheReader::u8() {
+    if (at + 1 > end) {
+        ok = false;
+        return NODE_NULL;
+    }
+    return *at++;
+}
+
+uint32_t CacheReader::u32() {
+    uint32_t value = 0;
+    if (at + sizeof(value) > end)
+        ok = false;
+    else {
+        memcpy(&value, at, sizeof(value));
+        at += sizeof(value);
+    }
+    return value;
+}
+
+SymbolId CacheReader::symbol() {
+    uint32_t index = u32();
+    if (index >= symbols.size()) {
+        ok = false;
+        return SYMBOL_NONE;
+    }
+    return symbols[index];
+}
+
+// The size of a list. Every item takes at least a byte, which keeps a bad count from making a huge list.
+uint32_t CacheReader::count() {
+    uint32_t size = u32();
+    if (size > (uint32_t) (end - at))
+        ok = false;
+    return ok ? size : 0;
+}
+
+// A string written with bytes(), copied into the arena with a terminator.
+const char* CacheReader::string() {
+    uint32_t size = count();
+    char* string = unit->arena.make_array<char>(size + 1);
+    if (ok)
+        memcpy(string, at, size);
+    string[ok ? size : 0] = '\0';
+    at += ok ? size : 0;
+    return string;
+}
+
+bool CacheReader::read() {
+    uint32_t symbol_count = count();
+    symbols.reserve(symbol_count);
+    for (uint32_t i = 0; i < symbol_count && ok; i++) {
+        uint32_t size = count();
+        if (ok) {
+            symbols.push_back(intern(std::string_view((const char*) at, size)));
+            at += size;
+        }
+    }
+
+    uint32_t size = count();
+    for (uint32_t i = 0; i < size && ok; i++) {
+        origin = unit->arena.make<Ast_Origin>();
+        origin->file = file;
+        origin->line = u32();
+
+        auto decleration = this->decleration();
+        if (decleration)
+            unit->declerations.push_back(unit->arena, decleration);
+    }
+    return ok && at == end;
+}
+
+Ast_Expression* CacheReader::expression() {
+    uint8_t type = u8();
+    if (type == NODE_NULL || !ok)
+        return nullptr;
+
+    uint32_t line = u32();
+    switch (type) {
+    case AST_PRIMARY: {
+        auto primary = node<Ast_PrimaryExpression>(line);
+        ok = ok && this->primary(primary);
+        return primary;
+    }
+    case AST_UNARY: {
+        auto unary = node<Ast_UnaryExpression>(line);
+        unary->op = (int) u32();
+        unary->next = expression();
+        return unary;
+    }
+    case AST_BINARY: {
+        auto binary = node<Ast_BinaryExpression>(line);
+        binary->op = (int) u32();
+        binary->left = expression();
+        binary->right = expression();
+        return binary;
+    }
+    case AST_ASSIGNMENT: {
+        auto assign = node<Ast_Assignment>(line);
+        assign->equal_type = (int) u32();
+        assign->id = symbol();
+        assign->expression = expression();
+        return assign;
+    }
+    }
+
+    ok = false;
+    return nullptr;
+}
+
+bool CacheReader::primary(Ast_PrimaryExpression* primary) {
+    primary->type_value = (int) u32();
+    primary->array_size = (int) u32();
+    switch (primary->type_value) {
+    case AST_FLOAT: {
+        uint32_t bits = u32();
+        memcpy(&primary->float_const, &bits, sizeof(bits));
+        return true;
+    }
+    case AST_INT:     primary->int_const = (int) u32(); return true;
+    case AST_BOOLEAN: primary->boolean = u8() != 0; return true;
+    case AST_CHAR:    primary->char_const = (char) u8(); return true;
+    case AST_INPUT:   primary->input_type = (int) u32(); return true;
+    case AST_ID:      primary->ident = symbol(); return true;
+    case AST_STRING:  primary->string = string(); return true;
+    case AST_NESTED:
+        primary->nested = expression();
+        return primary->nested != nullptr;
+    case AST_CAST:
+        primary->cast.cast_type = (int) u32();
+        primary->cast.expression = expression();
+        return primary->cast.expression != nullptr;
+    case AST_FUNC_CALL: {
+        SymbolId ident = symbol();
+        Ast_List<Ast_Expression*> args;
+        uint32_t size = count();
+        auto items = list(args, size);
+        for (uint32_t i = 0; i < size && ok; i++)
+            items[i] = expression();
+        primary->call = unit->arena.make<Ast_FunctionCall>(ident, args);
+        return true;
+    }
+    }
+    return false;
+}
+
+Ast_Decleration* CacheReader::decleration() {
+    uint8_t type = u8();
+    if (type == NODE_NULL || !ok)
+        return nullptr;
+    if (type == AST_IF || type == AST_WHILE)
+        return conditional(type);
+
+    uint32_t line = u32();
+    switch (type) {
+    case AST_EXPRESSION_STATEMENT: {
+        auto expression = this->expression();
+        auto statement = unit->arena.make<Ast_ExpressionStatement>(expression);
+        statement->line = line;
+        statement->origin = origin;
+        return statement;
+    }
+    case AST_PRINT: {
+        Ast_List<Ast_Expression*> expressions;
+        uint32_t size = count();
+        auto items = list(expressions, size);
+        for (uint32_t i = 0; i < size && ok; i++)
+            items[i] = expression();
+        auto print = unit->arena.make<Ast_PrintStatement>(expressions);
+        print->line = line;
+        print->origin = origin;
+        return print;
+    }
+    case AST_SCOPE: {
+        auto scope = node<Ast_Scope>(line);
+        uint32_t size = count();
+        auto items = list(scope->declerations, size);
+        for (uint32_t i = 0; i < size && ok; i++)
+            items[i] = decleration();
+        return scope;
+    }
+    case AST_VAR_DECLERATION: {
+        auto var = node<Ast_VarDecleration>(line);
+        var->type_value = (int) u32();
+        var->specifiers = (int) u32();
+        var->ident = symbol();
+        var->expression = expression();
+        return var;
+    }
+    case AST_FUNC_DECLERATION: {
+        auto func = node<Ast_FuncDecleration>(line);
+        func->ident = symbol();
+        func->return_type = (int) u32();
+        uint32_t size = count();
+        auto items = list(func->args, size);
+        for (uint32_t i = 0; i < size && ok; i++) {
+            auto arg = decleration();
+            ok = ok && arg && arg->type == AST_VAR_DECLERATION;
+            items[i] = AST_CAST(Ast_VarDecleration, arg);
+        }
+        func->scope = scope();
+        return func;
+    }
+    case AST_RETURN: {
+        auto expression = this->expression();
+        auto ret = unit->arena.make<Ast_ReturnStatement>(expression);
+        ret->line = line;
+        ret->origin = origin;
+        return ret;
+    }
+    case AST_IMPORT: {
+        auto import = unit->arena.make<Ast_ImportDecleration>(string());
+        import->line = line;
+        import->origin = origin;
+        return import;
+    }
+    }
+
+    ok = false;
+    return nullptr;
+}
+
+// A scope that has to be there, the body of a function or a conditional.
+Ast_Scope* CacheReader::scope() {
+    auto decleration = this->decleration();
+    if (!decleration || decleration->type != AST_SCOPE) {
+        ok = false;
+        return nullptr;
+    }
+    return AST_CAST(Ast_Scope, decleration);
+}
+
+Ast_ConditionalStatement* CacheReader::conditional(uint8_t type) {
+    Ast_ConditionalStatement* conditional = nullptr;
+    switch (type) {
+    case AST_IF:    conditional = unit->arena.make<Ast_IfStatement>(); break;
+    case AST_ELIF:  conditional = unit->arena.make<Ast_ElifStatement>(); break;
+    case AST_ELSE:  conditional = unit->arena.make<Ast_ElseStatement>(); break;
+    case AST_WHILE: conditional = unit->arena.make<Ast_WhileLoop>(); break;
+    default:
+        ok = false;
+        return nullptr;
+    }
+    conditional->line = u32();
+    conditional->origin = origin;
+    conditional->condition = expression();
+    conditional->scope = scope();
+
+    uint8_t next = u8();
+    if (next != NODE_NULL && ok)
+        conditional->next = this->conditional(next);
+    return conditional;
+}
+
+Ast_TranslationUnit* load_program_cache(const char* dir, Lexer& lexer) {
+    uint64_t hash = source_hash(*lexer.input);
+    Source file;
+    if (!file.open(cache_path(dir, hash).c_str()) || file.size() < sizeof(CacheHeader))
+        return nullptr;
+
+    CacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    const char* payload = file.data() + sizeof(header);
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.format != CACHE_FORMAT ||
+        header.version_major != YAPL_VERSION_MAJOR || header.version_minor != YAPL_VERSION_MINOR ||
+        header.source_hash != hash || header.source_size != lexer.input->size() ||
+        header.payload_size != file.size() - sizeof(header) || header.payload_hash != hash_bytes(payload, header.payload_size))
+        return nullptr;
+
+    Ast_TranslationUnit* unit = new Ast_TranslationUnit;
+    CacheReader reader(payload, header.payload_size, unit, lexer.file());
+    if (!reader.read()) {
+        delete unit;
+        return nullptr;
+    }
+    return unit;
+}
+
+/**
+ * The file is written under a name of its own and then renamed over the real one, which replaces
+ * it in one step. Other processes using the same cache directory see either the old file, the new
+ * one or none, never a part of one. The name has a count in it as well as the process id, since
+ * two modules with the same source can be saved from different threads at once.
+ */
+bool save_program_cache(const char* dir, Lexer& lexer, Ast_TranslationUnit* unit) {
+    std::string payload;
+    CacheWriter writer;
+    if (!writer.write(unit, payload))
+        return false;
+
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.format = CACHE_FORMAT;
+    header.version_major = YAPL_VERSION_MAJOR;
+    header.version_minor = YAPL_VERSION_MINOR;
+    header.source_hash = source_hash(*lexer.input);
+    header.source_size = lexer.input->size();
+    header.payload_hash = hash_bytes(payload.data(), payload.size());
+    header.payload_size = payload.size();
+
+#ifdef _WIN32
+    CreateDirectoryA(dir, NULL);
+#else
+    mkdir(dir, 0777);
+#endif
+
+    std::string path = cache_path(dir, header.source_hash);
+    static std::atomic<uint32_t> saves { 0 };
+    std::string temporary = path + "." + std::to_string((long long) getpid()) + "." + std::to_string(saves++) + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out)
+        return false;
+
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(payload.data(), 1, payload.size(), out) == payload.size();
+    written = (fclose(out) == 0) && written;
+
+#ifdef _WIN32
+    written = written && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    written = written && rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+    if (!written)
+        remove(temporary.c_str());
+    return written;
+}
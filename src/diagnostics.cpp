@@ -0,0 +1,46 @@
+/**
+ * @file diagnostics.cpp
+ * @author strah19
+ * @date July 15 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Collects the errors of the lexer and parser and writes them out together.
+ */
+
+#include "diagnostics.h"
+
+#include <string>
+
+DiagnosticSink::~DiagnosticSink() {
+    release();
+}
+
+/**
+ * Formats the pending errors the same way report_error does into one buffer and writes it to
+ * stdout in a single call, so a file with thousands of errors costs one write instead of thousands.
+ */
+void DiagnosticSink::flush() {
+    if (held || pending.empty())
+        return;
+
+    std::string out;
+    out.reserve(pending.size() * 96);
+    char line[512];
+    for (auto& diagnostic : pending) {
+        int length = snprintf(line, sizeof(line), "\033[0;31mYAPL error: \033[0mIn file '%s', on line %u: '%s'.\n", 
+            diagnostic.file, diagnostic.line, diagnostic.msg);
+        if (length > 0)
+            out.append(line, ((size_t) length < sizeof(line)) ? (size_t) length : sizeof(line) - 1);
+    }
+    pending.clear();
+
+    fwrite(out.data(), 1, out.size(), stdout);
+}
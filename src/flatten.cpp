@@ -0,0 +1,243 @@
+/**
+ * @file flatten.cpp
+ * @author strah19
+ * @date July 14 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Turns the expression trees of a translation unit into the flat, index based
+ * form the interpreter can walk without chasing pointers.
+ */
+
+#include "flatten.h"
+
+class Flattener {
+public:
+    Flattener(Ast_TranslationUnit* unit) : unit(unit), flat(&unit->flat) { }
+
+    void decleration(Ast_Decleration* decleration);
+    Ast_Expression* expression(Ast_Expression* expression);
+
+    FlattenStats stats;
+private:
+    bool is_flat(Ast_Expression* expression);
+    void operands(Ast_Expression* expression);
+    uint32_t node(Ast_Expression* expression);
+    uint32_t push(Ast_Expression* from, uint8_t kind, uint8_t op, uint32_t a, uint32_t b = 0);
+    uint16_t file_index(const char* file);
+
+    Ast_TranslationUnit* unit;
+    Ast_FlatExpressions* flat;
+};
+
+FlattenStats flatten_translation_unit(Ast_TranslationUnit* unit) {
+    Flattener flattener(unit);
+    for (auto decleration : unit->declerations)
+        flattener.decleration(decleration);
+    return flattener.stats;
+}
+
+void Flattener::decleration(Ast_Decleration* decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT: {
+        auto statement = AST_CAST(Ast_ExpressionStatement, decleration);
+        statement->expression = expression(statement->expression);
+        break;
+    }
+    case AST_PRINT: 
+        for (auto& printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            printed = expression(printed);
+        break;
+    case AST_VAR_DECLERATION: {
+        auto var = AST_CAST(Ast_VarDecleration, decleration);
+        var->expression = expression(var->expression);
+        break;
+    }
+    case AST_FUNC_DECLERATION: 
+        this->decleration(AST_CAST(Ast_FuncDecleration, decleration)->scope);
+        break;
+    case AST_SCOPE: 
+        for (auto inner : AST_CAST(Ast_Scope, decleration)->declerations)
+            this->decleration(inner);
+        break;
+    case AST_RETURN: {
+        auto ret = AST_CAST(Ast_ReturnStatement, decleration);
+        ret->expression = expression(ret->expression);
+        break;
+    }
+    case AST_IF: 
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE: 
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            conditional->condition = expression(conditional->condition);
+            this->decleration(conditional->scope);
+        }
+        break;
+    }
+}
+
+/**
+ * Flattens an expression tree.
+ * 
+ * @param Ast_Expression* The root of the tree, can be null.
+ * @return Ast_Expression* What should be stored in place of the root.
+ */
+Ast_Expression* Flattener::expression(Ast_Expression* expression) {
+    if (!expression)
+        return nullptr;
+
+    if (!is_flat(expression)) {
+        operands(expression);
+        return expression;
+    }
+
+    auto root = unit->arena.make<Ast_FlatExpression>(flat, node(expression));
+    root->line = expression->line;
+    root->origin = expression->origin;
+    root->value_type = expression->value_type;
+    return root;
+}
+
+bool Flattener::is_flat(Ast_Expression* expression) {
+    if (expression->type == AST_ASSIGNMENT)
+        return false;
+    if (expression->type == AST_PRIMARY) {
+        int type_value = AST_CAST(Ast_PrimaryExpression, expression)->type_value;
+        return type_value != AST_FUNC_CALL && type_value != AST_INPUT;
+    }
+    return expression->type == AST_BINARY || expression->type == AST_UNARY;
+}
+
+// Flattens what hangs off an expression that stays a pointer node.
+void Flattener::operands(Ast_Expression* expression) {
+    if (expression->type == AST_ASSIGNMENT) {
+        auto assign = AST_CAST(Ast_Assignment, expression);
+        // The interpreter looks for chained assignments by type, so those are left in place.
+        if (assign->expression->type == AST_ASSIGNMENT)
+            operands(assign->expression);
+        else
+            assign->expression = this->expression(assign->expression);
+    }
+    else if (expression->type == AST_PRIMARY) {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_FUNC_CALL)
+            for (auto& arg : primary->call->args)
+                arg = this->expression(arg);
+    }
+    else if (expression->type == AST_INLINE) {
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        for (auto& arg : inlined->args)
+            arg = this->expression(arg);
+        inlined->body = this->expression(inlined->body);
+    }
+    else if (expression->type == AST_INVARIANT) {
+        auto invariant = AST_CAST(Ast_LoopInvariant, expression);
+        invariant->expression = this->expression(invariant->expression);
+    }
+    else if (expression->type == AST_COMMON) {
+        auto common = AST_CAST(Ast_CommonExpression, expression);
+        if (common->expression)
+            common->expression = this->expression(common->expression);
+    }
+    else if (expression->type == AST_INDUCTION) {
+        auto induction = AST_CAST(Ast_Induction, expression);
+        induction->left = this->expression(induction->left);
+        induction->right = this->expression(induction->right);
+    }
+}
+
+// Adds an expression and everything under it to the node array, children first.
+uint32_t Flattener::node(Ast_Expression* expression) {
+    if (!is_flat(expression)) {
+        operands(expression);
+        flat->trees.push_back(expression);
+        return push(expression, AST_FLAT_TREE, 0, (uint32_t) flat->trees.size() - 1);
+    }
+
+    switch (expression->type) {
+    case AST_BINARY: {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        uint32_t left = node(binary->left);
+        uint32_t right = node(binary->right);
+        stats.tree_bytes += sizeof(Ast_BinaryExpression);
+        uint32_t index = push(expression, AST_FLAT_BINARY, (uint8_t) binary->op, left, right);
+        if (binary->value_type != AST_TYPE_NONE)
+            flat->nodes[index].type = (uint8_t) binary->left->value_type;
+        return index;
+    }
+    case AST_UNARY: {
+        auto unary = AST_CAST(Ast_UnaryExpression, expression);
+        uint32_t next = node(unary->next);
+        stats.tree_bytes += sizeof(Ast_UnaryExpression);
+        uint32_t index = push(expression, AST_FLAT_UNARY, (uint8_t) unary->op, next);
+        if (unary->value_type != AST_TYPE_NONE)
+            flat->nodes[index].type = (uint8_t) unary->next->value_type;
+        return index;
+    }
+    default:
+        break;
+    }
+
+    auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+    stats.tree_bytes += sizeof(Ast_PrimaryExpression);
+    switch (primary->type_value) {
+    case AST_NESTED: 
+        // Brackets only group, the nested expression takes the place of the node.
+        return node(primary->nested);
+    case AST_INT: 
+        return push(expression, AST_FLAT_INT, 0, (uint32_t) primary->int_const);
+    case AST_FLOAT: {
+        uint32_t bits;
+        memcpy(&bits, &primary->float_const, sizeof(bits));
+        return push(expression, AST_FLAT_FLOAT, 0, bits);
+    }
+    case AST_CHAR: 
+        return push(expression, AST_FLAT_CHAR, 0, (uint32_t) (uint8_t) primary->char_const);
+    case AST_BOOLEAN: 
+        return push(expression, AST_FLAT_BOOLEAN, 0, primary->boolean ? 1 : 0);
+    case AST_STRING: 
+        flat->strings.push_back(primary->string);
+        return push(expression, AST_FLAT_STRING, 0, (uint32_t) flat->strings.size() - 1);
+    case AST_ID: 
+        return push(expression, AST_FLAT_ID, 0, primary->address.slot, primary->address.depth);
+    case AST_CAST: {
+        uint32_t casted = node(primary->cast.expression);
+        return push(expression, AST_FLAT_CAST, (uint8_t) primary->cast.cast_type, casted);
+    }
+    default:
+        flat->trees.push_back(expression);
+        return push(expression, AST_FLAT_TREE, 0, (uint32_t) flat->trees.size() - 1);
+    }
+}
+
+uint32_t Flattener::push(Ast_Expression* from, uint8_t kind, uint8_t op, uint32_t a, uint32_t b) {
+    flat->nodes.push_back({ kind, AST_TYPE_NONE, op, file_index(from->file()), a, b });
+    flat->lines.push_back(from->source_line());
+    stats.nodes++;
+    return (uint32_t) flat->nodes.size() - 1;
+}
+
+uint16_t Flattener::file_index(const char* file) {
+    // Almost always the file of the node before.
+    if (!flat->files.empty() && flat->files.back()->file == file)
+        return (uint16_t) (flat->files.size() - 1);
+    for (size_t i = 0; i < flat->files.size(); i++)
+        if (flat->files[i]->file == file)
+            return (uint16_t) i;
+
+    auto origin = unit->arena.make<Ast_Origin>();
+    origin->file = file;
+    flat->files.push_back(origin);
+    return (uint16_t) (flat->files.size() - 1);
+}
@@ -0,0 +1,357 @@
+/**
+ * @file checker.cpp
+ * @author strah19
+ * @date July 22 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Works out the type of every expression of a program before it is run.
+ */
+
+#include "checker.h"
+
+//error messages
+#define OPERANDS_DIFFER "Operands in expression must be of the same type"
+#define OPERATOR_TYPE "Operator can not be used on this type"
+#define NEGATE_TYPE "Type cannot be negated"
+#define CONVERT_TYPE "Unable to convert between types"
+#define DECLERATION_TYPE "Types do not match in variable decleration"
+#define ASSIGN_TYPE "Types do not match in assignment"
+#define ASSIGN_CONSTANT "Can not have assignment on constant variable"
+#define PARAMS_TYPE "Function arguments do not match the paramters"
+#define RETURN_TYPE "Types do not match in return expression"
+#define RETURN_FULL "Function was returned with expression when return type is void"
+#define RETURN_NULL "Function was returned with nothing when it has a return type"
+#define NO_RETURN "Function with a return type never returns"
+
+#define TYPE_BIT(type) (1u << (type))
+
+// The types each operator works on, as the objects of the interpreter have them.
+static const uint32_t NUMBERS = TYPE_BIT(AST_FLOAT) | TYPE_BIT(AST_INT) | TYPE_BIT(AST_BOOLEAN) | TYPE_BIT(AST_CHAR);
+static const uint32_t INTEGERS = TYPE_BIT(AST_INT) | TYPE_BIT(AST_BOOLEAN) | TYPE_BIT(AST_CHAR);
+
+/**
+ * The type of what a binary operator gives for operands of a type.
+ *
+ * @return int The type, or AST_TYPE_NONE when the operator can not be used on the type.
+ */
+static int operation(int op, int type) {
+    if (type == AST_VOID || type == AST_TYPE_NONE)
+        return AST_TYPE_NONE;
+
+    uint32_t bit = TYPE_BIT(type);
+    switch (op) {
+    case AST_OPERATOR_ADD:
+        return (bit & (NUMBERS | TYPE_BIT(AST_STRING))) ? type : AST_TYPE_NONE;
+    case AST_OPERATOR_SUB:
+    case AST_OPERATOR_MULTIPLICATIVE:
+    case AST_OPERATOR_DIVISION:
+        return (bit & NUMBERS) ? type : AST_TYPE_NONE;
+    case AST_OPERATOR_MODULO:
+        return (bit & INTEGERS) ? type : AST_TYPE_NONE;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:
+        return (bit & (NUMBERS | TYPE_BIT(AST_STRING))) ? AST_BOOLEAN : AST_TYPE_NONE;
+    case AST_OPERATOR_GT:
+    case AST_OPERATOR_LT:
+    case AST_OPERATOR_GTE:
+    case AST_OPERATOR_LTE:
+    case AST_OPERATOR_AND:
+    case AST_OPERATOR_OR:
+        return (bit & NUMBERS) ? AST_BOOLEAN : AST_TYPE_NONE;
+    case AST_OPERATOR_BIT_AND:
+    case AST_OPERATOR_BIT_OR:
+    case AST_OPERATOR_BIT_XOR:
+    case AST_OPERATOR_BIT_LEFT:
+    case AST_OPERATOR_BIT_RIGHT:
+        return (bit & INTEGERS) ? AST_BOOLEAN : AST_TYPE_NONE;
+    }
+    return AST_TYPE_NONE;
+}
+
+int Checker::assignment_operator(int equal_type) {
+    switch (equal_type) {
+    case AST_EQUAL_PLUS:     return AST_OPERATOR_ADD;
+    case AST_EQUAL_MINUS:    return AST_OPERATOR_SUB;
+    case AST_EQUAL_MULTIPLY: return AST_OPERATOR_MULTIPLICATIVE;
+    case AST_EQUAL_DIVIDE:   return AST_OPERATOR_DIVISION;
+    case AST_EQUAL_MOD:      return AST_OPERATOR_MODULO;
+    }
+    return AST_OPERATOR_NONE;
+}
+
+static bool can_convert(int from, int to) {
+    if (from == to)
+        return true;
+    if (to == AST_INT)
+        return from == AST_CHAR || from == AST_FLOAT;
+    if (to == AST_CHAR || to == AST_FLOAT)
+        return from == AST_INT;
+    return false;
+}
+
+void Checker::check(Ast_TranslationUnit* unit) {
+    this->unit = unit;
+    for (auto decleration : unit->declerations)
+        this->decleration(decleration);
+}
+
+void Checker::decleration(Ast_Decleration* decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        expression(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+        break;
+    case AST_PRINT:
+        for (auto printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            expression(printed);
+        break;
+    case AST_SCOPE:
+        for (auto inner : AST_CAST(Ast_Scope, decleration)->declerations)
+            this->decleration(inner);
+        break;
+    case AST_VAR_DECLERATION: {
+        auto var = AST_CAST(Ast_VarDecleration, decleration);
+        int type = expression(var->expression);
+        if (type != AST_TYPE_NONE && type != var->type_value)
+            error(*var->expression, DECLERATION_TYPE);
+        break;
+    }
+    case AST_FUNC_DECLERATION:
+        function(AST_CAST(Ast_FuncDecleration, decleration));
+        break;
+    case AST_RETURN:
+        // Only a return at the top of a function body ends it, see function.
+        expression(AST_CAST(Ast_ReturnStatement, decleration)->expression);
+        break;
+    case AST_IF:
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE:
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            expression(conditional->condition);
+            this->decleration(conditional->scope);
+        }
+        break;
+    }
+}
+
+// A body the parser skipped is left as it is, it is run without types once it is parsed.
+void Checker::function(Ast_FuncDecleration* func) {
+    for (auto arg : func->args)
+        arguments.insert(arg);
+    if (!func->scope)
+        return;
+
+    bool returns = false;
+    for (auto decleration : func->scope->declerations) {
+        if (decleration->type != AST_RETURN) {
+            this->decleration(decleration);
+            continue;
+        }
+
+        auto ret = AST_CAST(Ast_ReturnStatement, decleration);
+        int type = expression(ret->expression);
+        if (func->return_type == AST_VOID && ret->expression)
+            error(*ret, RETURN_FULL);
+        else if (func->return_type != AST_VOID && !ret->expression)
+            error(*ret, RETURN_NULL);
+        else if (type != AST_TYPE_NONE && type != func->return_type)
+            error(*ret, RETURN_TYPE);
+        returns = true;
+    }
+
+    if (func->return_type != AST_VOID && !returns)
+        error(*func, NO_RETURN);
+}
+
+int Checker::expression(Ast_Expression* expression) {
+    if (!expression)
+        return AST_TYPE_NONE;
+
+    switch (expression->type) {
+    case AST_PRIMARY:
+        expression->value_type = primary(AST_CAST(Ast_PrimaryExpression, expression));
+        break;
+    case AST_UNARY:
+        expression->value_type = unary(AST_CAST(Ast_UnaryExpression, expression));
+        break;
+    case AST_BINARY: {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        int left = this->expression(binary->left);
+        expression->value_type = this->binary(binary->op, left, binary->right, *binary);
+        break;
+    }
+    case AST_ASSIGNMENT:
+        expression->value_type = assignment(AST_CAST(Ast_Assignment, expression));
+        break;
+    }
+    return expression->value_type;
+}
+
+int Checker::primary(Ast_PrimaryExpression* primary) {
+    switch (primary->type_value) {
+    case AST_FLOAT:
+    case AST_INT:
+    case AST_STRING:
+    case AST_CHAR:
+    case AST_BOOLEAN:
+        return primary->type_value;
+    case AST_INPUT:
+        return primary->input_type;
+    case AST_NESTED:
+        return expression(primary->nested);
+    case AST_ID:
+        return variable(primary->address.variable);
+    case AST_FUNC_CALL:
+        return call(primary->call, *primary);
+    case AST_CAST: {
+        int type = expression(primary->cast.expression);
+        if (type == AST_TYPE_NONE)
+            return AST_TYPE_NONE;
+        if (!can_convert(type, primary->cast.cast_type)) {
+            error(*primary, CONVERT_TYPE);
+            return AST_TYPE_NONE;
+        }
+        return primary->cast.cast_type;
+    }
+    }
+    return AST_TYPE_NONE;
+}
+
+int Checker::call(Ast_FunctionCall* call, const Ast& at) {
+    bool typed = true;
+    for (auto arg : call->args)
+        typed &= expression(arg) != AST_TYPE_NONE;
+
+    Ast_FuncDecleration* func = call->function;
+    if (!func || !typed)
+        return AST_TYPE_NONE;
+
+    bool matches = func->args.size() == call->args.size();
+    for (uint32_t i = 0; matches && i < call->args.size(); i++)
+        matches = call->args[i]->value_type == func->args[i]->type_value;
+    if (!matches) {
+        error(at, PARAMS_TYPE);
+        return AST_TYPE_NONE;
+    }
+    return result(func);
+}
+
+/**
+ * Works out the type of a binary operator. An int on the right of a float is turned into a float
+ * here, the same way the interpreter does it for values.
+ *
+ * @param int The type of the left operand.
+ * @param Ast_Expression*& The right operand, replaced by a cast when it is converted.
+ */
+int Checker::binary(int op, int left, Ast_Expression*& right, const Ast& at) {
+    int type = expression(right);
+    if (left == AST_TYPE_NONE || type == AST_TYPE_NONE)
+        return AST_TYPE_NONE;
+
+    if (left == AST_FLOAT && type == AST_INT) {
+        auto cast = unit->arena.make<Ast_PrimaryExpression>();
+        cast->type_value = AST_CAST;
+        cast->cast.cast_type = AST_FLOAT;
+        cast->cast.expression = right;
+        cast->value_type = type = AST_FLOAT;
+        cast->line = right->line;
+        cast->origin = right->origin;
+        right = cast;
+    }
+
+    if (left != type) {
+        error(at, OPERANDS_DIFFER);
+        return AST_TYPE_NONE;
+    }
+
+    int result = operation(op, left);
+    if (result == AST_TYPE_NONE)
+        error(at, OPERATOR_TYPE);
+    return result;
+}
+
+int Checker::unary(Ast_UnaryExpression* unary) {
+    int type = expression(unary->next);
+    if (type == AST_TYPE_NONE)
+        return AST_TYPE_NONE;
+
+    if (unary->op == AST_UNARY_MINUS) {
+        if (type == AST_FLOAT || type == AST_INT)
+            return type;
+        error(*unary, NEGATE_TYPE);
+        return AST_TYPE_NONE;
+    }
+
+    uint32_t types = (unary->op == AST_UNARY_NOT) ? TYPE_BIT(AST_FLOAT) | TYPE_BIT(AST_INT) | TYPE_BIT(AST_BOOLEAN) : INTEGERS;
+    if (type == AST_VOID || !(TYPE_BIT(type) & types)) {
+        error(*unary, OPERATOR_TYPE);
+        return AST_TYPE_NONE;
+    }
+    return AST_BOOLEAN;
+}
+
+// A chained assignment gives the variable the value of the assignment after it, whatever the operator.
+int Checker::assignment(Ast_Assignment* assign) {
+    int type = variable(assign->address.variable);
+    int value = AST_TYPE_NONE;
+    if (assign->expression->type == AST_ASSIGNMENT || assign->equal_type == AST_EQUAL)
+        value = expression(assign->expression);
+    else
+        value = binary(assignment_operator(assign->equal_type), type, assign->expression, *assign);
+
+    if (type == AST_TYPE_NONE || value == AST_TYPE_NONE)
+        return AST_TYPE_NONE;
+    if (value != type) {
+        error(*assign, ASSIGN_TYPE);
+        return AST_TYPE_NONE;
+    }
+    if (assign->address.variable->specifiers & AST_SPECIFIER_CONST) {
+        error(*assign, ASSIGN_CONSTANT);
+        return AST_TYPE_NONE;
+    }
+    return type;
+}
+
+// A variable declared without a value holds nothing of its type, and can never be given one.
+int Checker::variable(Ast_VarDecleration* var) {
+    if (!var || (!var->expression && arguments.count(var) == 0))
+        return AST_TYPE_NONE;
+    return var->type_value;
+}
+
+/**
+ * The type of what calling a function gives. A function gives what its first return at the top
+ * of its body gives, or nothing when there is no such return.
+ */
+int Checker::result(Ast_FuncDecleration* func) {
+    auto found = results.find(func);
+    if (found != results.end())
+        return found->second;
+
+    int type = AST_TYPE_NONE;
+    if (func->return_type == AST_VOID)
+        type = AST_VOID;
+    else if (func->scope) {
+        for (auto decleration : func->scope->declerations)
+            if (decleration->type == AST_RETURN)
+                type = func->return_type;
+    }
+
+    results.emplace(func, type);
+    return type;
+}
+
+void Checker::error(const Ast& at, const char* msg) {
+    diagnostics.error(at.file(), at.source_line(), msg);
+}
@@ -18,86 +18,33 @@
 #include "environment.h"
 #include "interpreter.h"
 
-void Environment::var_define(const char* name, Object object) {
-    values[name] = object;
-}
-
-int Environment::var_update(const char* name, Object object) {
-    if (var_found(name)) {
-        Object o = values[name];
-        if (o.type != object.type)
-            return EN_ERROR_WRONG_TYPE_ASSIGN;
-        values[name] = object; 
-        return EN_ERROR_NONE;
-    }
-    if (!var_found(name) && previous) {
-        if (!found_errors(previous->var_update(name, object)))
-            return EN_ERROR_NONE;
-    }
-
-    if (!var_found(name)) 
-        return EN_ERROR_UNDEFINED_VAR;
-    return EN_ERROR_NONE;
-}
-
-Object Environment::var_get(const char* name) {
-    if (!var_found(name) && previous)
-        return previous->var_get(name); 
-
-    if (!var_found(name)) 
-        return Object(OBJ_ERROR_UNDEFINED_VAR);
-
-    return values[name];
-}
-
-int Environment::var_is_defined(const char* name) {
-    if (var_found(name))
-        return EN_ERROR_NONE;
+#include <algorithm>
 
-    if (!var_found(name) && previous) {
-        if (!found_errors(previous->var_is_defined(name)))
-            return EN_ERROR_NONE;
-    }
-    
-    if (!var_found(name)) 
-        return EN_ERROR_UNDEFINED_VAR;
-    return EN_ERROR_NONE;
-}
+// An undefined slot, reading one is the error of a variable that is not there.
+static const Object UNDEFINED(OBJ_ERROR_UNDEFINED_VAR);
 
-bool Environment::var_found(const char* name) {
-    return (values.find(name) != values.end());
+uint32_t Environment::reserve(uint32_t size) {
+    uint32_t base = (uint32_t) slots.size();
+    slots.resize(base + size, UNDEFINED);
+    return base;
 }
 
-int Environment::func_is_defined(const char* name) {
-    if (func_found(name))
-        return EN_ERROR_NONE;
+void Environment::enter(uint32_t base, uint32_t depth) {
+    uint32_t enclosing = frames.empty() ? 0 : (uint32_t) frames.size() - 1;
+    for (uint32_t i = 0; i < depth; i++)
+        enclosing = frames[enclosing].enclosing;
 
-    if (!func_found(name) && previous) {
-        if (!found_errors(previous->func_is_defined(name)))
-            return EN_ERROR_NONE;
-    }
-    
-    if (!func_found(name)) 
-        return EN_ERROR_UNDEFINED_FUNC;
-    return EN_ERROR_NONE;
+    frames.push_back({ base, enclosing });
 }
 
-void Environment::func_define(const char* name, Ast_FuncDecleration* func) {
-    functions[name] = func;
+void Environment::pop() {
+    slots.resize(frames.back().base);
+    frames.pop_back();
 }
 
-bool Environment::func_found(const char* name) {
-    return (functions.find(name) != functions.end());
-}
-
-Ast_FuncDecleration* Environment::func_get(const char* name) {
-    if (!func_found(name) && previous)
-        return previous->func_get(name); 
-
-    if (!func_found(name)) 
-        return nullptr;
-
-    return functions[name];
+void Environment::clear(uint32_t first, uint32_t count) {
+    Object* frame = slots.data() + frames.back().base;
+    std::fill(frame + first, frame + first + count, UNDEFINED);
 }
 
 bool Environment::found_errors(int error) {
@@ -16,8 +16,15 @@
  */
 
 #include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "checker.h"
 #include "err.h"
 #include <iostream>
+#include <type_traits>
+
+//error messages
+#define CONSTANT_ASSIGNMENT "Can not have assignment on constant variable."
 
 #define OBJECT_ERRORS(ast, obj) if (obj.found_errors()) throw Interpreter::construct_runtime_error(*ast, OBJ_ERROR_MESSAGES[obj.error]);
 #define ENVIRONMENT_ERRORS(ast, err) if (Environment::found_errors(err)) throw Interpreter::construct_runtime_error(*ast, EN_ERROR_MESSAGES[err]);
@@ -25,9 +32,10 @@
 static bool is_if_or_elif(int type);
 
 void Interpreter::interpret(Ast_TranslationUnit* unit) {
-    current_environment = &environment;
+    this->unit = unit;
+    environment.enter(environment.reserve(unit->frame_size));
     try {
-        for (int i = 0; i < unit->declerations.size(); i++)
+        for (uint32_t i = 0; i < unit->declerations.size(); i++)
             execute(unit->declerations[i]);
     }
     catch (RunTimeError error) {
@@ -38,6 +46,8 @@ void Interpreter::interpret(Ast_TranslationUnit* unit) {
 void Interpreter::execute(Ast_Decleration* decleration) {
     if (decleration->type == AST_EXPRESSION_STATEMENT) 
         evaluate_expression(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+    else if (decleration->type == AST_INCREMENT)
+        increment(AST_CAST(Ast_Increment, decleration));
     else if (decleration->type == AST_SCOPE)
         scope(decleration);
     else if (decleration->type == AST_PRINT) 
@@ -48,31 +58,21 @@ void Interpreter::execute(Ast_Decleration* decleration) {
         if_statement(AST_CAST(Ast_ConditionalStatement, decleration));
     else if (decleration->type == AST_WHILE)
         while_loop(AST_CAST(Ast_WhileLoop, decleration)); 
-    else if (decleration->type == AST_FUNC_DECLERATION) 
-        function_decleration(AST_CAST(Ast_FuncDecleration, decleration));
-}
-
-void Interpreter::function_decleration(Ast_FuncDecleration* func) {
-    if (current_environment->func_is_defined(func->ident) == EN_ERROR_NONE) 
-        throw construct_runtime_error(*func, "Function can only be defined once");
-    current_environment->func_define(func->ident, func);
 }
 
+// The variables of a scope are undefined again once it ends, so the next time through a loop can
+// declare them again and what comes after the scope can use the slots.
 void Interpreter::scope(Ast_Decleration* decleration) {
-    Environment* previous = current_environment;
-    current_environment->next = new Environment;
-    current_environment = current_environment->next;
-    current_environment->previous = previous;
     auto scope = AST_CAST(Ast_Scope, decleration);
-
-    for (int i = 0; i < scope->declerations.size(); i++)
+    for (uint32_t i = 0; i < scope->declerations.size(); i++)
         execute(scope->declerations[i]);
-    current_environment = current_environment->previous;
-    delete current_environment->next;
-    current_environment->next = nullptr;
+
+    environment.clear(scope->first_slot, scope->slot_count);
 }
 
 void Interpreter::while_loop(Ast_WhileLoop* loop) {
+    environment.clear(loop->first_invariant, loop->invariant_count);
+    environment.clear(loop->first_induction, loop->induction_count);
     Object obj = evaluate_expression(loop->condition);
     OBJECT_ERRORS(loop, obj);
 
@@ -115,29 +115,45 @@ bool Interpreter::conditional_statement(Ast_ConditionalStatement* conditional) {
 }
 
 void Interpreter::variable_decleration(Ast_VarDecleration* decleration) {
-    if (current_environment->var_found(decleration->ident)) 
+    Ast_Address address = { 0, decleration->slot };
+    if (Environment::var_defined(environment.var(address))) 
         throw construct_runtime_error(*decleration, OBJ_ERROR_MESSAGES[OBJ_ERROR_REDEFINITION]);
-    current_environment->var_define(decleration->ident, Object());
+    environment.var(address) = Object();
     if (decleration->expression) {
-        Object obj;
-        if (decleration->expression) {
-            obj = evaluate_expression(decleration->expression);
-            OBJECT_ERRORS(decleration->expression, obj);   
-            if (convert_to_interpreter_type(decleration->type_value) != obj.type) {
-                throw construct_runtime_error(*decleration, OBJ_ERROR_MESSAGES[OBJ_ERROR_WRONG_TYPE]);
-            }        
-        }
-        else
-            obj.type = convert_to_interpreter_type(decleration->type_value);
+        Object obj = evaluate_expression(decleration->expression);
+        OBJECT_ERRORS(decleration->expression, obj);   
+        if (decleration->expression->value_type != decleration->type_value && convert_to_interpreter_type(decleration->type_value) != obj.type)
+            throw construct_runtime_error(*decleration, OBJ_ERROR_MESSAGES[OBJ_ERROR_WRONG_TYPE]);
             
         obj.mutability = (decleration->specifiers & AST_SPECIFIER_CONST) ? false : true;
-        current_environment->var_define(decleration->ident, obj);
+        environment.var(address) = obj;
     }
     else if ((decleration->specifiers & AST_SPECIFIER_CONST)) throw construct_runtime_error(*decleration, "constant variable must have an expression.");
 }
 
+// Adds to the variable where it is, failing the way the assignment it was made from would have.
+void Interpreter::increment(Ast_Increment* increment) {
+    Object& var = environment.var(increment->address);
+    OBJECT_ERRORS(increment, var);
+    if (!var.mutability)
+        throw construct_runtime_error(*increment, CONSTANT_ASSIGNMENT);
+
+    // Made again like the assignment would, a variable declared without a value has no type yet.
+    if (increment->value_type == AST_FLOAT) {
+        var = Object::init_float(var.float_const + increment->float_const);
+        return;
+    }
+
+    var = Object::init_int(var.int_const + increment->int_const);
+    for (auto slot : increment->inductions) {
+        Object& induction = environment.var({ 0, slot });
+        if (Environment::var_defined(induction))
+            induction.int_const += increment->int_const * environment.var({ 0, slot + 1 }).int_const;
+    }
+}
+
 void Interpreter::print_statement(Ast_PrintStatement* print) {
-    for (int i = 0; i < print->expressions.size(); i++) {
+    for (uint32_t i = 0; i < print->expressions.size(); i++) {
         Object obj = evaluate_expression(print->expressions[i]);
         OBJECT_ERRORS(print, obj);             
         switch (obj.type) {
@@ -162,28 +178,36 @@ void Interpreter::print_statement(Ast_PrintStatement* print) {
     }
 }
 
+// A chained assignment gives each variable the value the one after it was given.
 Object Interpreter::assignment(Ast_Assignment* assign) {
-    if (assign->expression->type == AST_ASSIGNMENT)
-        assignment(AST_CAST(Ast_Assignment, assign->expression));
-    ENVIRONMENT_ERRORS(assign, current_environment->var_is_defined(assign->id));
-
     Object obj;
-    if (assign->expression->type == AST_ASSIGNMENT) {
-        auto id = new Ast_PrimaryExpression(AST_CAST(Ast_Assignment, assign->expression)->id);
-        obj = evaluate_expression(id);
-        OBJECT_ERRORS(assign, obj);
-        delete id;
-    }
+    if (assign->expression->type == AST_ASSIGNMENT)
+        obj = assignment(AST_CAST(Ast_Assignment, assign->expression));
     else 
         obj = evaluate_equal(assign);
-    ENVIRONMENT_ERRORS(assign, current_environment->var_update(assign->id, obj));
+
+    // Looked up after the value, working it out can call a function and move the slots.
+    Object& var = environment.var(assign->address);
+    if (!Environment::var_defined(var))
+        throw construct_runtime_error(*assign, EN_ERROR_MESSAGES[EN_ERROR_UNDEFINED_VAR]);
+    if (assign->value_type == AST_TYPE_NONE && var.type != obj.type)
+        throw construct_runtime_error(*assign, EN_ERROR_MESSAGES[EN_ERROR_WRONG_TYPE_ASSIGN]);
+    // Being constant belongs to the variable, the value of a constant does not make this one constant.
+    var = obj;
+    var.mutability = true;
     return obj;
 }
 
 Object Interpreter::evaluate_equal(Ast_Assignment* assign) {
-    Object obj = current_environment->var_get(assign->id);
+    Object obj = environment.var(assign->address);
     OBJECT_ERRORS(assign, obj);
 
+    if (assign->value_type != AST_TYPE_NONE && assign->equal_type != AST_EQUAL) {
+        Object result = apply_typed_binary(Checker::assignment_operator(assign->equal_type), assign->value_type, obj, evaluate_expression(assign->expression));
+        OBJECT_ERRORS(assign, result);
+        return result;
+    }
+
     switch(assign->equal_type) {
     case AST_EQUAL:          return evaluate_expression(assign->expression); 
     case AST_EQUAL_PLUS:     return obj + evaluate_expression(assign->expression); 
@@ -200,7 +224,7 @@ RunTimeError Interpreter::construct_runtime_error(Ast ast, const char* msg) {
 }
 
 void Interpreter::print_runtime_error(const RunTimeError& runtime_error) {
-    report_runtime_error("In file '%s' on line %d: '%s'.\n", runtime_error.ast.file, runtime_error.ast.line, runtime_error.msg);
+    report_runtime_error("In file '%s' on line %d: '%s'.\n", runtime_error.ast.file(), runtime_error.ast.source_line(), runtime_error.msg);
 }
 
 Object Interpreter::evaluate_expression(Ast_Expression* expression) {
@@ -209,14 +233,85 @@ Object Interpreter::evaluate_expression(Ast_Expression* expression) {
     case AST_ASSIGNMENT: return evaluate_assignment(AST_CAST(Ast_Assignment, expression));
     case AST_PRIMARY:    return evaluate_primary(AST_CAST(Ast_PrimaryExpression, expression));
     case AST_UNARY:      return evaluate_unary(AST_CAST(Ast_UnaryExpression, expression));
+    case AST_INLINE:     return evaluate_inline(AST_CAST(Ast_InlineCall, expression));
+    case AST_INVARIANT:  return evaluate_invariant(AST_CAST(Ast_LoopInvariant, expression));
+    case AST_INDUCTION:  return evaluate_induction(AST_CAST(Ast_Induction, expression));
+    case AST_COMMON:     return evaluate_common(AST_CAST(Ast_CommonExpression, expression));
+    case AST_FLAT: {
+        auto flat = AST_CAST(Ast_FlatExpression, expression);
+        return evaluate_flat(flat->flat, flat->root);
+    }
+    }
+
+    return Object();
+}
+
+/**
+ * Evaluates an expression in its flat form, mirrors evaluate_expression on the tree nodes.
+ * 
+ * @param const Ast_FlatExpressions* The arrays the expression lives in.
+ * @param uint32_t The index of the node to evaluate.
+ * @return Object The value of the expression.
+ */
+Object Interpreter::evaluate_flat(const Ast_FlatExpressions* flat, uint32_t index) {
+    const Ast_FlatNode& node = flat->nodes[index];
+    switch (node.kind) {
+    case AST_FLAT_INT:     return Object::init_int((int) node.a);
+    case AST_FLAT_CHAR:    return Object::init_char((char) node.a);
+    case AST_FLAT_BOOLEAN: return Object::init_bool(node.a != 0);
+    case AST_FLAT_STRING:  return Object::init_str(flat->strings[node.a]);
+    case AST_FLAT_FLOAT: {
+        float float_const;
+        memcpy(&float_const, &node.a, sizeof(float_const));
+        return Object::init_float(float_const);
+    }
+    case AST_FLAT_ID: {
+        Object obj = environment.var({ node.b, node.a });
+        if (obj.found_errors())
+            throw construct_runtime_error(flat->location(index), OBJ_ERROR_MESSAGES[obj.error]);
+        return obj;
+    }
+    case AST_FLAT_UNARY: 
+        if (node.type != AST_TYPE_NONE)
+            return apply_typed_unary(node.op, node.type, evaluate_flat(flat, node.a));
+        return apply_unary(node.op, evaluate_flat(flat, node.a));
+    case AST_FLAT_BINARY: {
+        Object left = evaluate_flat(flat, node.a);
+        Object right = evaluate_flat(flat, node.b);
+        if (node.type == AST_TYPE_NONE)
+            return apply_binary(node.op, left, right);
+
+        Object result = apply_typed_binary(node.op, node.type, left, right);
+        if (result.found_errors())
+            throw construct_runtime_error(flat->location(index), OBJ_ERROR_MESSAGES[result.error]);
+        return result;
+    }
+    case AST_FLAT_CAST: {
+        Object obj = evaluate_flat(flat, node.a);
+        if (obj.found_errors())
+            throw construct_runtime_error(flat->location(index), OBJ_ERROR_MESSAGES[obj.error]);
+        Object casting_obj;
+        casting_obj.type = convert_to_interpreter_type(node.op);
+        int errors = obj.convert(casting_obj);
+        if (errors != OBJ_ERROR_NONE)
+            throw construct_runtime_error(flat->location(index), OBJ_ERROR_MESSAGES[errors]);
+        return obj;
+    }
+    case AST_FLAT_TREE: 
+        return evaluate_expression(flat->trees[node.a]);
     }
 
     return Object();
 }
 
 Object Interpreter::evaluate_unary(Ast_UnaryExpression* unary) {
-    Object value = evaluate_expression(unary->next);
-    switch (unary->op) {
+    if (unary->value_type != AST_TYPE_NONE)
+        return apply_typed_unary(unary->op, unary->next->value_type, evaluate_expression(unary->next));
+    return apply_unary(unary->op, evaluate_expression(unary->next));
+}
+
+Object Interpreter::apply_unary(int op, Object value) {
+    switch (op) {
     case AST_UNARY_MINUS:   return -value;
     case AST_UNARY_NOT:     return !value;
     case AST_UNARY_BIT_NOT: return ~value;
@@ -225,6 +320,27 @@ Object Interpreter::evaluate_unary(Ast_UnaryExpression* unary) {
     return value;
 }
 
+// The value is of the type the checker gave the operand, which the operator works on.
+Object Interpreter::apply_typed_unary(int op, int type, const Object& value) {
+    switch (op) {
+    case AST_UNARY_MINUS:
+        return (type == AST_FLOAT) ? Object::init_float(-value.float_const) : Object::init_int(-value.int_const);
+    case AST_UNARY_NOT:
+        switch (type) {
+        case AST_FLOAT: return Object::init_bool(!value.float_const);
+        case AST_INT:   return Object::init_bool(!value.int_const);
+        default:        return Object::init_bool(!value.boolean);
+        }
+    case AST_UNARY_BIT_NOT:
+        switch (type) {
+        case AST_INT:  return Object::init_bool(~value.int_const);
+        case AST_CHAR: return Object::init_bool(~value.char_const);
+        default:       return Object::init_bool(~(int) value.boolean);
+        }
+    }
+    return Object(OBJ_ERROR_UNKNOWN_OPERATOR);
+}
+
 Object Interpreter::evaluate_primary(Ast_PrimaryExpression* primary) {
     switch (primary->type_value) {
     case AST_NESTED:  return evaluate_expression(primary->nested);
@@ -234,12 +350,12 @@ Object Interpreter::evaluate_primary(Ast_PrimaryExpression* primary) {
     case AST_CHAR:    return Object::init_char(primary->char_const);
     case AST_BOOLEAN: return Object::init_bool(primary->boolean);
     case AST_ID: {
-        Object obj  = current_environment->var_get(primary->ident);
+        Object obj = environment.var(primary->address);
         OBJECT_ERRORS(primary, obj);
         return obj;
     }   
     case AST_FUNC_CALL: {
-        Object obj = evaluate_function_call(primary->call);
+        Object obj = evaluate_function_call(primary->call, primary->value_type != AST_TYPE_NONE);
         OBJECT_ERRORS(primary, obj);
         return obj;
     }
@@ -285,60 +401,191 @@ Object Interpreter::evaluate_primary(Ast_PrimaryExpression* primary) {
     }
 }
 
-Object Interpreter::evaluate_function_call(Ast_FunctionCall* call) {
-    if (current_environment->func_is_defined(call->ident) == EN_ERROR_UNDEFINED_FUNC) 
+Object Interpreter::evaluate_function_call(Ast_FunctionCall* call, bool checked) {
+    Ast_FuncDecleration* dec = call->function;
+    if (!dec) 
         return Object(OBJ_ERROR_UNDEFINED_FUNC);
     
-    Ast_FuncDecleration* dec = current_environment->func_get(call->ident);
-    if (dec) 
-        return execute_function(dec, call);
-
-    return Object(OBJ_ERROR_NONE);
+    if (!dec->scope) {
+        if (!unit->parser->parse_body(dec))
+            return Object(OBJ_ERROR_BAD_BODY);
+        unit->resolver->resolve_body(dec);
+    }
+    return execute_function(dec, call, checked);
 }
 
-Object Interpreter::execute_function(Ast_FuncDecleration* function, Ast_FunctionCall* call) {
-    Environment* previous = current_environment;
-    current_environment->next = new Environment;
-    current_environment = current_environment->next;
-    current_environment->previous = previous;
-
+/**
+ * Runs a function in a frame of its own. The arguments are worked out in the caller's frame and 
+ * go straight into the first slots of the new one. The frame is dropped on every way out but an
+ * error thrown, which ends the program anyway. The types of the arguments are checked here unless
+ * the checker found them to be those of the parameters.
+ */
+Object Interpreter::execute_function(Ast_FuncDecleration* function, Ast_FunctionCall* call, bool checked) {
     if (function->args.size() != call->args.size())
         return Object(OBJ_ERROR_PARAMS);
-        
-    for (int i = 0; i < function->args.size(); i++) {
+
+    uint32_t frame = environment.reserve(function->frame_size);
+    for (uint32_t i = 0; i < function->args.size(); i++) {
         Object arg = evaluate_expression(call->args[i]);
         OBJECT_ERRORS(call->args[i], arg);
-        current_environment->var_define(function->args[i]->ident, arg);
-    }
-
-    for (int i = 0; i < function->scope->declerations.size(); i++) {
-        if (function->scope->declerations[i]->type == AST_RETURN) {
-            auto ret = AST_CAST(Ast_ReturnStatement, function->scope->declerations[i]);
-            if (function->return_type == AST_VOID && ret->expression) return Object(OBJ_ERROR_RETURN_FULL);
-            else if (function->return_type != AST_VOID && !ret->expression) return Object(OBJ_ERROR_RETURN_IS_NULL);
-
-            if (!ret->expression)
-                return Object(OBJ_ERROR_NONE);
-            else if (ret->expression) {
-                Object obj_return = evaluate_expression(ret->expression);
-                if (obj_return.type != convert_to_interpreter_type(function->return_type))
-                    return Object(OBJ_ERROR_WRONG_RET_TYPE);
-                OBJECT_ERRORS(ret->expression, obj_return);
-                return obj_return;
-            }
+        if (!checked && arg.type != convert_to_interpreter_type(function->args[i]->type_value))
+            throw construct_runtime_error(*call->args[i], OBJ_ERROR_MESSAGES[OBJ_ERROR_PARAMS]);
+        // The parameter is constant if it is declared so, whatever the argument was.
+        arg.mutability = !(function->args[i]->specifiers & AST_SPECIFIER_CONST);
+        environment.slot(frame + function->args[i]->slot) = arg;
+    }
+    environment.enter(frame, call->depth);
+
+    Object result(OBJ_ERROR_NONE);
+    for (uint32_t i = 0; i < function->scope->declerations.size(); i++) {
+        if (function->scope->declerations[i]->type != AST_RETURN) {
+            execute(function->scope->declerations[i]);
+            continue;
         }
-        execute(function->scope->declerations[i]);
+
+        auto ret = AST_CAST(Ast_ReturnStatement, function->scope->declerations[i]);
+        if (function->return_type == AST_VOID && ret->expression) 
+            result = Object(OBJ_ERROR_RETURN_FULL);
+        else if (function->return_type != AST_VOID && !ret->expression) 
+            result = Object(OBJ_ERROR_RETURN_IS_NULL);
+        else if (ret->expression) {
+            result = evaluate_expression(ret->expression);
+            if (ret->expression->value_type != function->return_type && result.type != convert_to_interpreter_type(function->return_type))
+                result = Object(OBJ_ERROR_WRONG_RET_TYPE);
+            else
+                OBJECT_ERRORS(ret->expression, result);
+        }
+        break;
+    }
+
+    environment.pop();
+    return result;
+}
+
+// Does what execute_function does for a call the optimizer inlined, without a frame of its own.
+Object Interpreter::evaluate_inline(Ast_InlineCall* call) {
+    for (uint32_t i = 0; i < call->args.size(); i++) {
+        Object arg = evaluate_expression(call->args[i]);
+        OBJECT_ERRORS(call->args[i], arg);
+        // The checker gives an assignment to a constant parameter no type, so those are never inlined.
+        arg.mutability = true;
+        environment.var({ 0, call->first_slot + i }) = arg;
     }
-    current_environment = current_environment->previous;
-    delete current_environment->next;
-    return Object(OBJ_ERROR_NONE);
+
+    Object result = evaluate_expression(call->body);
+    OBJECT_ERRORS(call->body, result);
+    return result;
+}
+
+// A value with an error is passed on without being kept, it is worked out again the next time
+// like the expression would have been.
+Object Interpreter::evaluate_invariant(Ast_LoopInvariant* invariant) {
+    Object& kept = environment.var({ 0, invariant->slot });
+    if (Environment::var_defined(kept))
+        return kept;
+
+    Object obj = evaluate_expression(invariant->expression);
+    if (!obj.found_errors())
+        environment.var({ 0, invariant->slot }) = obj;
+    return obj;
+}
+
+// Works the product out like a binary expression would the first time, and keeps it along with the
+// invariant side for the increments of the variable, see increment.
+Object Interpreter::evaluate_induction(Ast_Induction* induction) {
+    Object& kept = environment.var({ 0, induction->slot });
+    if (Environment::var_defined(kept))
+        return kept;
+
+    Object left = evaluate_expression(induction->left);
+    Object right = evaluate_expression(induction->right);
+    Object product = apply_typed_binary(AST_OPERATOR_MULTIPLICATIVE, AST_INT, left, right);
+    if (!left.found_errors() && !right.found_errors()) {
+        environment.var({ 0, induction->slot }) = product;
+        environment.var({ 0, induction->slot + 1 }) = induction->variable_left ? right : left;
+    }
+    return product;
+}
+
+Object Interpreter::evaluate_common(Ast_CommonExpression* common) {
+    if (!common->expression)
+        return environment.var({ 0, common->slot });
+
+    Object obj = evaluate_expression(common->expression);
+    environment.var({ 0, common->slot }) = obj;
+    return obj;
 }
 
 Object Interpreter::evaluate_binary(Ast_BinaryExpression* binary) {
     auto left = evaluate_expression(binary->left);
     auto right = evaluate_expression(binary->right);
+    if (binary->value_type == AST_TYPE_NONE)
+        return apply_binary(binary->op, left, right);
+
+    // Dividing by zero is the only way a typed operator fails.
+    Object result = apply_typed_binary(binary->op, binary->left->value_type, left, right);
+    OBJECT_ERRORS(binary, result);
+    return result;
+}
+
+/**
+ * Applies a binary operator to two values of a type, the way the objects do it but without
+ * looking at their types. A boolean and a char are worked out as ints and the result turned
+ * back, like the objects do, booleans are passed in as ints to do that.
+ */
+template <typename T>
+static Object typed_binary(int op, T left, T right, Object (*init)(T)) {
+    switch (op) {
+    case AST_OPERATOR_ADD:                   return init(left + right);
+    case AST_OPERATOR_SUB:                   return init(left - right);
+    case AST_OPERATOR_MULTIPLICATIVE:        return init(left * right);
+    case AST_OPERATOR_DIVISION:
+        if (right == 0)
+            return Object(OBJ_ERROR_DIVIDE_ZERO);
+        return init(left / right);
+    case AST_OPERATOR_COMPARITIVE_EQUAL:     return Object::init_bool(left == right);
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL: return Object::init_bool(left != right);
+    case AST_OPERATOR_GT:                    return Object::init_bool(left > right);
+    case AST_OPERATOR_LT:                    return Object::init_bool(left < right);
+    case AST_OPERATOR_GTE:                   return Object::init_bool(left >= right);
+    case AST_OPERATOR_LTE:                   return Object::init_bool(left <= right);
+    case AST_OPERATOR_AND:                   return Object::init_bool(left && right);
+    case AST_OPERATOR_OR:                    return Object::init_bool(left || right);
+    }
+
+    if constexpr (std::is_integral_v<T>) {
+        switch (op) {
+        case AST_OPERATOR_MODULO:
+            if (right == 0)
+                return Object(OBJ_ERROR_DIVIDE_ZERO);
+            return init(left % right);
+        case AST_OPERATOR_BIT_AND:   return Object::init_bool((left & right) != 0);
+        case AST_OPERATOR_BIT_OR:    return Object::init_bool((left | right) != 0);
+        case AST_OPERATOR_BIT_XOR:   return Object::init_bool((left ^ right) != 0);
+        case AST_OPERATOR_BIT_LEFT:  return Object::init_bool((left << right) != 0);
+        case AST_OPERATOR_BIT_RIGHT: return Object::init_bool((left >> right) != 0);
+        }
+    }
+    return Object(OBJ_ERROR_UNKNOWN_OPERATOR);
+}
+
+static Object init_bool_from_int(int value) {
+    return Object::init_bool(value);
+}
+
+// Both values are of the type the checker gave the operands. Strings go through the objects.
+Object Interpreter::apply_typed_binary(int op, int type, const Object& left, const Object& right) {
+    switch (type) {
+    case AST_INT:     return typed_binary<int>(op, left.int_const, right.int_const, Object::init_int);
+    case AST_FLOAT:   return typed_binary<float>(op, left.float_const, right.float_const, Object::init_float);
+    case AST_CHAR:    return typed_binary<char>(op, left.char_const, right.char_const, Object::init_char);
+    case AST_BOOLEAN: return typed_binary<int>(op, left.boolean, right.boolean, init_bool_from_int);
+    default:          return apply_binary(op, left, right);
+    }
+}
 
-    switch (binary->op) {
+Object Interpreter::apply_binary(int op, Object left, Object right) {
+    switch (op) {
     case AST_OPERATOR_ADD:                   return left + right;
     case AST_OPERATOR_MULTIPLICATIVE:        return left * right; 
     case AST_OPERATOR_SUB:                   return left - right;
@@ -362,10 +609,10 @@ Object Interpreter::evaluate_binary(Ast_BinaryExpression* binary) {
 }
 
 Object Interpreter::evaluate_assignment(Ast_Assignment* assign) {
-    Object obj = current_environment->var_get(assign->id);
+    Object obj = environment.var(assign->address);
     OBJECT_ERRORS(assign, obj);
     if (!obj.mutability)
-        throw construct_runtime_error(*assign, "Can not have assignment on constant variable.");
+        throw construct_runtime_error(*assign, CONSTANT_ASSIGNMENT);
     return assignment(assign); 
 }
 
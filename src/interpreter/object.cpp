@@ -23,7 +23,7 @@ Object Object::operator+(const Object& obj) {
     this->error |= check_operators(o);
     if (found_errors()) return Object(this->error);
     switch (this->type) {
-    case FLOAT:   return Object::init_float(this->float_const + obj.float_const);
+    case FLOAT:   return Object::init_float(this->float_const + o.float_const);
     case INT:     return Object::init_int(this->int_const + obj.int_const);
     case BOOLEAN: return Object::init_bool(this->boolean + o.boolean);
     case STRING:  return Object::init_str(strcat((char*) this->str, (char*) o.str));
@@ -64,6 +64,7 @@ Object Object::operator*(const Object& obj) {
 Object Object::operator%(const Object& obj) {
     Object o = obj;
     this->error |= check_operators(o);
+    this->error |= Object::check_divide_by_zero(o);
     if (found_errors()) return Object(this->error);
     switch (this->type) {
     case INT:     return Object::init_int(this->int_const % obj.int_const);
@@ -177,8 +178,8 @@ Object Object::operator<=(const Object& obj) {
 
 Object Object::operator-() {
     switch (this->type) {
-        case FLOAT: return -this->float_const;
-        case INT:   return -this->int_const;
+        case FLOAT: return Object::init_float(-this->float_const);
+        case INT:   return Object::init_int(-this->int_const);
         default: cannot_negate_type_error();
     }
     return *this;
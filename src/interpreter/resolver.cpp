@@ -0,0 +1,229 @@
+/**
+ * @file resolver.cpp
+ * @author strah19
+ * @date July 20 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Works out where every variable of a program lives before it is run.
+ */
+
+#include "resolver.h"
+
+//error messages
+#define FUNCTION_REDEFINED "Function can only be defined once"
+
+void Resolver::resolve(Ast_TranslationUnit* unit) {
+    unit->resolver = this;
+
+    // Slot 0 is where the names that are not found point.
+    frame = Frame();
+    frame.next = frame.size = 1;
+
+    begin_scope(unit->declerations, 0);
+    for (auto decleration : unit->declerations)
+        this->decleration(decleration);
+    end_scope();
+
+    unit->frame_size = frame.size;
+    if (skipped.empty())
+        scopes.clear();
+}
+
+void Resolver::resolve_body(Ast_FuncDecleration* func) {
+    auto found = skipped.find(func);
+    if (found == skipped.end())
+        return;
+
+    Scope* enclosing = found->second;
+    skipped.erase(found);
+    body(func, enclosing);
+}
+
+/**
+ * Starts a scope in the frame of the given level. The functions declared in it are known from
+ * the start, so they can be called before the declaration and from each other.
+ */
+void Resolver::begin_scope(const Ast_List<Ast_Decleration*>& declerations, uint32_t level) {
+    scopes.emplace_back();
+    Scope* scope = &scopes.back();
+    scope->parent = current;
+    scope->level = level;
+    current = scope;
+
+    for (auto decleration : declerations) {
+        if (!decleration || decleration->type != AST_FUNC_DECLERATION)
+            continue;
+
+        auto func = AST_CAST(Ast_FuncDecleration, decleration);
+        auto defined = scope->functions.emplace(func->ident, func);
+        // Two modules defining a function was reported when they were linked.
+        if (!defined.second && defined.first->second->file() == func->file())
+            diagnostics.error(func->file(), func->source_line(), FUNCTION_REDEFINED);
+    }
+}
+
+// Resolves the bodies of the functions declared in the scope, now that all of its names are known.
+void Resolver::end_scope() {
+    Scope* scope = current;
+    for (size_t i = 0; i < scope->bodies.size(); i++)
+        body(scope->bodies[i], scope);
+    current = scope->parent;
+}
+
+/**
+ * Resolves a function body in a frame of its own, the arguments take the first slots. A body the
+ * parser skipped is put aside with its scope until resolve_body.
+ */
+void Resolver::body(Ast_FuncDecleration* func, Scope* enclosing) {
+    if (!func->scope) {
+        skipped[func] = enclosing;
+        return;
+    }
+
+    Scope* outer = current;
+    Frame outer_frame = frame;
+    current = enclosing;
+    frame = Frame();
+
+    begin_scope(func->scope->declerations, enclosing->level + 1);
+    for (auto arg : func->args)
+        decleration(arg);
+    for (auto decleration : func->scope->declerations)
+        this->decleration(decleration);
+    end_scope();
+
+    func->frame_size = frame.size;
+    current = outer;
+    frame = outer_frame;
+}
+
+// A variable declared again in the same scope gets the same slot, running the second one is an error.
+void Resolver::declare(Ast_VarDecleration* var) {
+    auto declared = current->variables.emplace(var->ident, var);
+    if (!declared.second) {
+        var->slot = declared.first->second->slot;
+        declared.first->second = var;
+        return;
+    }
+
+    var->slot = frame.next++;
+    frame.size = (frame.next > frame.size) ? frame.next : frame.size;
+}
+
+void Resolver::decleration(Ast_Decleration* decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        expression(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+        break;
+    case AST_PRINT:
+        for (auto printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            expression(printed);
+        break;
+    case AST_SCOPE:
+        block(AST_CAST(Ast_Scope, decleration));
+        break;
+    case AST_VAR_DECLERATION: {
+        // The variable is there while its initializer runs, as it always has been.
+        auto var = AST_CAST(Ast_VarDecleration, decleration);
+        declare(var);
+        expression(var->expression);
+        break;
+    }
+    case AST_FUNC_DECLERATION:
+        current->bodies.push_back(AST_CAST(Ast_FuncDecleration, decleration));
+        break;
+    case AST_RETURN:
+        expression(AST_CAST(Ast_ReturnStatement, decleration)->expression);
+        break;
+    case AST_IF:
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE:
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            expression(conditional->condition);
+            this->decleration(conditional->scope);
+        }
+        break;
+    }
+}
+
+// A scope inside a function or the program takes the next slots of its frame, and gives them back
+// when it ends so the scope after it can use them again.
+void Resolver::block(Ast_Scope* scope) {
+    scope->first_slot = frame.next;
+    begin_scope(scope->declerations, current->level);
+    for (auto decleration : scope->declerations)
+        this->decleration(decleration);
+    scope->slot_count = frame.next - scope->first_slot;
+    end_scope();
+    frame.next = scope->first_slot;
+}
+
+void Resolver::expression(Ast_Expression* expression) {
+    if (!expression)
+        return;
+
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_ID)
+            primary->address = address(primary->ident);
+        else if (primary->type_value == AST_NESTED)
+            this->expression(primary->nested);
+        else if (primary->type_value == AST_CAST)
+            this->expression(primary->cast.expression);
+        else if (primary->type_value == AST_FUNC_CALL)
+            call(primary->call);
+        break;
+    }
+    case AST_UNARY:
+        this->expression(AST_CAST(Ast_UnaryExpression, expression)->next);
+        break;
+    case AST_BINARY:
+        this->expression(AST_CAST(Ast_BinaryExpression, expression)->left);
+        this->expression(AST_CAST(Ast_BinaryExpression, expression)->right);
+        break;
+    case AST_ASSIGNMENT: {
+        auto assign = AST_CAST(Ast_Assignment, expression);
+        assign->address = address(assign->id);
+        this->expression(assign->expression);
+        break;
+    }
+    }
+}
+
+// A call to a function that is not found is left unbound, running it is an error.
+void Resolver::call(Ast_FunctionCall* call) {
+    call->function = nullptr;
+    for (Scope* scope = current; scope; scope = scope->parent) {
+        auto found = scope->functions.find(call->ident);
+        if (found != scope->functions.end()) {
+            call->function = found->second;
+            call->depth = current->level - scope->level;
+            break;
+        }
+    }
+
+    for (auto arg : call->args)
+        expression(arg);
+}
+
+Ast_Address Resolver::address(SymbolId name) {
+    for (Scope* scope = current; scope; scope = scope->parent) {
+        auto found = scope->variables.find(name);
+        if (found != scope->variables.end())
+            return { current->level - scope->level, found->second->slot, found->second };
+    }
+    return { current->level, 0 };
+}
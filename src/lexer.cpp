@@ -16,16 +16,24 @@
  */
 
 #include <stdio.h>
-#include <sys/stat.h>
 #include <stdlib.h>
-#include <ctype.h>
-#include <fstream>
-#include <map>
+#include <charconv>
 
 #include "lexer.h"
 #include "err.h"
+#include "thread_pool.h"
+#include "scan.h"
+#include "spsc_ring.h"
 
-static std::map<std::string, int> keywords = {
+#include <algorithm>
+#include <memory>
+
+struct Keyword {
+    std::string_view text;
+    int type;
+};
+
+static constexpr Keyword KEYWORDS[] = {
     { "if", Tok::T_IF },
     { "else", Tok::T_ELSE },
     { "elif", Tok::T_ELIF },
@@ -35,7 +43,6 @@ static std::map<std::string, int> keywords = {
     { "break", Tok::T_BREAK },
     { "boolean", Tok::T_BOOLEAN },
     { "float", Tok::T_FLOAT },
-    { "return", Tok::T_RETURN },
     { "print", Tok::T_PRINT },
     { "string", Tok::T_STRING },
     { "func", Tok::T_FUNC },
@@ -49,233 +56,867 @@ static std::map<std::string, int> keywords = {
     { "char", Tok::T_CHAR },
     { "cast", Tok::T_CAST },
     { "int", Tok::T_INT },
-    { "input", Tok::T_INPUT }
+    { "input", Tok::T_INPUT },
+    { "import", Tok::T_IMPORT }
 };
 
-static std::map<std::string, int> symbols = {
-    { "<=", Tok::T_LTE },
-    { ">=", Tok::T_GTE },
-    { "!=", Tok::T_NOT_EQUAL },
-    { "==", Tok::T_COMPARE_EQUAL },
-    { "->", Tok::T_DASH_ARROW },
-    { "+=", Tok::T_EQUAL_PLUS },
-    { "-=", Tok::T_EQUAL_MINUS },
-    { "*=", Tok::T_EQUAL_STAR },
-    { "/=", Tok::T_EQUAL_SLASH },
-    { "<<", Tok::T_BIT_LEFT },
-    { ">>", Tok::T_BIT_RIGHT },
-    { "%=", Tok::T_EQUAL_MOD }
+struct Symbol {
+    char first;
+    char second;
+    int type;
 };
 
-// different types of general tokens used when lexing
+static constexpr Symbol SYMBOLS[] = {
+    { '<', '=', Tok::T_LTE },
+    { '>', '=', Tok::T_GTE },
+    { '!', '=', Tok::T_NOT_EQUAL },
+    { '=', '=', Tok::T_COMPARE_EQUAL },
+    { '-', '>', Tok::T_DASH_ARROW },
+    { '+', '=', Tok::T_EQUAL_PLUS },
+    { '-', '=', Tok::T_EQUAL_MINUS },
+    { '*', '=', Tok::T_EQUAL_STAR },
+    { '/', '=', Tok::T_EQUAL_SLASH },
+    { '<', '<', Tok::T_BIT_LEFT },
+    { '>', '>', Tok::T_BIT_RIGHT },
+    { '%', '=', Tok::T_EQUAL_MOD }
+};
+
+// Keys packed into 32 bits for the perfect hashes. A keyword is keyed by its length and its
+// first, second and last characters which is unique for every keyword (the text is still compared
+// on a hit since identifiers can share a key with one). A symbol is keyed by both of its characters.
+static constexpr uint32_t keyword_key(std::string_view text) {
+    return (uint32_t) text.size() | ((uint32_t) (uint8_t) text[0] << 8) | 
+           ((uint32_t) (uint8_t) text[1] << 16) | ((uint32_t) (uint8_t) text[text.size() - 1] << 24);
+}
+
+static constexpr uint32_t symbol_key(char first, char second) {
+    return (uint32_t) (uint8_t) first | ((uint32_t) (uint8_t) second << 8);
+}
+
+struct HashEntry {
+    uint32_t key = 0;
+    int value = 0;
+};
+
+template <uint32_t BITS>
+struct PerfectHash {
+    static constexpr uint32_t SIZE = 1 << BITS;
+
+    uint32_t seed = 0;
+    HashEntry entries[SIZE] = { };
+
+    constexpr uint32_t slot(uint32_t key) const {
+        return (key * seed) >> (32 - BITS);
+    }
+};
+
+// Searches for a multiplier that maps every key to its own slot. This is all done by the compiler, 
+// a seed of 0 means no multiplier was found and is caught by the static_asserts below.
+template <uint32_t BITS, uint32_t N>
+static constexpr PerfectHash<BITS> build_perfect_hash(const HashEntry (&keys)[N]) {
+    for (uint32_t i = 0; i < 0x10000; i++) {
+        PerfectHash<BITS> hash;
+        hash.seed = 0x9E3779B1 + i * 2;
+
+        bool collided = false;
+        for (uint32_t j = 0; j < N && !collided; j++) {
+            HashEntry& entry = hash.entries[hash.slot(keys[j].key)];
+            if (entry.key != 0)
+                collided = true;
+            entry = keys[j];
+        }
+
+        if (!collided) 
+            return hash;
+    }
+    return PerfectHash<BITS>();
+}
+
+template <uint32_t N>
+struct HashKeys {
+    HashEntry keys[N] = { };
+};
+
+static constexpr auto keyword_keys() {
+    HashKeys<sizeof(KEYWORDS) / sizeof(Keyword)> k;
+    for (uint32_t i = 0; i < sizeof(KEYWORDS) / sizeof(Keyword); i++) 
+        k.keys[i] = { keyword_key(KEYWORDS[i].text), (int) i };
+    return k;
+}
+
+static constexpr auto symbol_keys() {
+    HashKeys<sizeof(SYMBOLS) / sizeof(Symbol)> k;
+    for (uint32_t i = 0; i < sizeof(SYMBOLS) / sizeof(Symbol); i++) 
+        k.keys[i] = { symbol_key(SYMBOLS[i].first, SYMBOLS[i].second), SYMBOLS[i].type };
+    return k;
+}
+
+static constexpr auto KEYWORD_HASH = build_perfect_hash<6>(keyword_keys().keys);
+static constexpr auto SYMBOL_HASH = build_perfect_hash<6>(symbol_keys().keys);
+
+static_assert(KEYWORD_HASH.seed != 0, "no perfect hash found for the keywords");
+static_assert(SYMBOL_HASH.seed != 0, "no perfect hash found for the symbols");
+static_assert(Tok::T_DASH_ARROW <= 0xFF, "token kinds have to fit in a TokenKind");
+
+// The class of every byte, it picks which state the lexer moves into when a token starts.
 enum {
-    IDENTIFIER = 1,
-    NUMERIC,
-    SYMBOL,
-    STRING,
-    SINGLE_LINE_COMMENT,
-    MULTI_LINE_COMMENT
+    CHAR_INVALID,
+    CHAR_SPACE,
+    CHAR_NEWLINE,
+    CHAR_ALPHA,
+    CHAR_DIGIT,
+    CHAR_QUOTE,
+    CHAR_APOSTROPHE,
+    CHAR_SYMBOL
+};
+
+struct CharClasses {
+    uint8_t table[256] = { };
 };
 
+static constexpr CharClasses build_char_classes() {
+    CharClasses classes;
+    for (int c = '!'; c <= '~'; c++) 
+        classes.table[c] = CHAR_SYMBOL;
+    for (int c = 'a'; c <= 'z'; c++) 
+        classes.table[c] = CHAR_ALPHA;
+    for (int c = 'A'; c <= 'Z'; c++) 
+        classes.table[c] = CHAR_ALPHA;
+    for (int c = '0'; c <= '9'; c++) 
+        classes.table[c] = CHAR_DIGIT;
+    
+    classes.table['_'] = CHAR_ALPHA;
+    classes.table['"'] = CHAR_QUOTE;
+    classes.table['\''] = CHAR_APOSTROPHE;
+    classes.table[' '] = CHAR_SPACE;
+    classes.table['\t'] = CHAR_SPACE;
+    classes.table['\r'] = CHAR_SPACE;
+    classes.table['\v'] = CHAR_SPACE;
+    classes.table['\f'] = CHAR_SPACE;
+    classes.table['\n'] = CHAR_NEWLINE;
+    return classes;
+}
+
+static constexpr CharClasses CHAR_CLASSES = build_char_classes();
+
+static inline uint8_t char_class(char c) {
+    return CHAR_CLASSES.table[(uint8_t) c];
+}
+
+static inline bool is_identifier_char(char c) {
+    uint8_t type = char_class(c);
+    return (type == CHAR_ALPHA || type == CHAR_DIGIT);
+}
+
+static inline bool is_digit(char c) {
+    return (char_class(c) == CHAR_DIGIT);
+}
+
 /**
  * Constructor for the lexer, takes in the source file for analysis.
  * 
  * @param const char* The path to the source file.
  */
+// A run of tokens handed from the lexer thread to the parser, along with the errors found while 
+// lexing them and the index of the token each error came up in.
+struct TokenBatch {
+    static constexpr uint32_t SIZE = 256;
+
+    struct Error {
+        uint32_t at;
+        LexerError error;
+    };
+
+    Token tokens[SIZE];
+    uint32_t count = 0;
+    std::vector<Error> errors;
+};
+
+struct Lexer::Pipeline {
+    SpscRing<TokenBatch, 64> ring;
+    std::thread thread;
+    std::atomic<bool> stopping { false };
+
+    // The batch the parser is reading from.
+    TokenBatch* batch = nullptr;
+    uint32_t index = 0;
+    uint32_t error_index = 0;
+};
+
 Lexer::Lexer(const char* filepath) : filepath(filepath) {
     load();
+    end_index = source.size();
+}
+
+Lexer::~Lexer() {
+    if (pipeline && pipeline->thread.joinable()) {
+        pipeline->stopping.store(true, std::memory_order_relaxed);
+        pipeline->thread.join();
+    }
 }
 
-char Lexer::incr_char(int32_t off) {
-    return stream[current_index + off];
+/**
+ * Creates a lexer for one chunk of a parallel lex. It shares the source of the main lexer, 
+ * counts lines from 0 and holds on to its errors until the chunks are stitched together.
+ */
+Lexer::Lexer(const Source* input, const char* filepath, uint32_t begin, uint32_t end, uint32_t nested_comment) : 
+    filepath(filepath), input(input), current_index(begin), end_index(end), current_line(0), nested_comment(nested_comment), defer_errors(true) {
 }
 
-bool Lexer::is_identifier(char c) {
-    return (isalpha(c) || c == '_');
+void Lexer::lexer_error(uint32_t line, const char* msg) {
+    if (defer_errors)
+        errors.push_back({ line, msg });
+    else
+        diagnostics.error(filepath, line, msg);
 }
 
-bool Lexer::is_spec_char(char c) {
-    return (c == ' ' || c == '\n' || c == '\t');
+int Lexer::find_keyword(std::string_view text) {
+    if (text.size() < 2) 
+        return 0;
+
+    uint32_t key = keyword_key(text);
+    const HashEntry& entry = KEYWORD_HASH.entries[KEYWORD_HASH.slot(key)];
+    if (entry.key == key && KEYWORDS[entry.value].text == text)
+        return KEYWORDS[entry.value].type;
+    return 0;
 }
 
-void Lexer::remove_whitespaces(char* s) {
-    char* d = s;
-    do while (isspace(*s)) s++; while (*d++ = *s++);
+int Lexer::find_symbol(char first, char second) {
+    uint32_t key = symbol_key(first, second);
+    const HashEntry& entry = SYMBOL_HASH.entries[SYMBOL_HASH.slot(key)];
+    return (entry.key == key) ? entry.value : 0;
 }
 
-void Lexer::newline() {
-    if (stream[current_index] == '\n') {
-        current_line++;
-        current_type = (current_type == SINGLE_LINE_COMMENT) ? 0 : current_type;
+/**
+ * Scans the next token starting at the current index. Whitespace and comments are skipped
+ * and the class of the first character decides which state handles the rest of the token.
+ * 
+ * @return Token The token, T_EOF once the end of the source is reached.
+ */
+Token Lexer::scan() {
+    if (nested_comment > 0)
+        multiline_comment();
+
+    const char* data = input->data();
+
+    while (current_index < end_index) {
+        char c = data[current_index];
+        token_start = current_index;
+        switch (char_class(c)) {
+        case CHAR_SPACE:
+            // Tokens are mostly apart by a single space, the bulk skip is only called for more.
+            if (++current_index < end_index && char_class(data[current_index]) > CHAR_NEWLINE)
+                break;
+            current_index = skip_whitespace(data, current_index, end_index, current_line);
+            break;
+        case CHAR_NEWLINE:
+            current_index = skip_whitespace(data, current_index, end_index, current_line);
+            break;
+        case CHAR_ALPHA:      return identifier();
+        case CHAR_DIGIT:      return numeric();
+        case CHAR_QUOTE:      return string_const();
+        case CHAR_APOSTROPHE: return char_const();
+        case CHAR_SYMBOL: {
+            char next = input->at(current_index + 1);
+            if (c == '/' && next == '/') 
+                singleline_comment();
+            else if (c == '<' && next == '/') {
+                current_index += 2;
+                nested_comment = 1;
+                multiline_comment();
+            }
+            else
+                return symbol();
+            break;
+        }
+        default:
+            lexer_error(current_line, "Unexpected character in source");
+            current_index++;
+            break;
+        }
     }
+
+    return Token(Tok::T_EOF, current_line);
 }
 
 void Lexer::singleline_comment() {
-    if (stream[current_index] == '/' && incr_char() == '/') {
-        current_type = (current_type == 0) ? SINGLE_LINE_COMMENT : current_type;
-        move();
-    }   
+    current_index = find_byte(input->data(), current_index, end_index, '\n');
 }
 
-void Lexer::multiline_comment_beg() {
-    if (stream[current_index] == '<' && incr_char() == '/') {
-        nested_comment++;
-        current_type = MULTI_LINE_COMMENT;
-        move();
+// Comments are written as '</ ... />' and can be nested.
+void Lexer::multiline_comment() {
+    const char* data = input->data();
+
+    while (nested_comment > 0) {
+        // Only '<' and '/' can open or close a comment, everything between them is skipped in bulk.
+        current_index = find_either(data, current_index, end_index, '<', '/', current_line);
+        if (current_index >= end_index)
+            break;
+
+        char c = data[current_index];
+        if (c == '<' && input->at(current_index + 1) == '/') {
+            nested_comment++;
+            current_index++;
+        }
+        else if (c == '/' && input->at(current_index + 1) == '>') {
+            nested_comment--;
+            current_index++;
+        }
+        current_index++;
     }
 }
 
-void Lexer::multiline_comment_end() {
-    if (stream[current_index] == '/' && incr_char() == '>') {
-        nested_comment--;
-        current_type = (nested_comment == 0) ? 0 : current_type;
-        move();
-    }
+Token Lexer::identifier() {
+    const char* data = input->data();
+    uint32_t start = current_index;
+
+    uint32_t hash = SYMBOL_HASH_BASIS;
+    while (current_index < end_index && is_identifier_char(data[current_index]))
+        hash = hash_symbol(hash, data[current_index++]);
+
+    std::string_view text = input->view(start, current_index - start);
+    int keyword = find_keyword(text);
+    if (keyword)
+        return Token(keyword, current_line);
+
+    Token token(Tok::T_IDENTIFIER, current_line);
+    token.symbol = symbols.intern(text, hash);
+    return token;
 }
 
-void Lexer::create_sym_token() {
-    for (int i = 0; i < current.size(); i++) {
-        if (symbols.find(current) != symbols.end()) {
-            tokens.push_back(Token(symbols[current], current_line));
-            return;
-        }
+Token Lexer::numeric() {
+    const char* data = input->data();
+    uint32_t start = current_index;
+    bool has_dec = false;
+
+    while (current_index < end_index && is_digit(data[current_index]))
+        current_index++;
+    
+    if (current_index < end_index && data[current_index] == '.') {
+        has_dec = true;
+        current_index++;
+        while (current_index < end_index && is_digit(data[current_index]))
+            current_index++;
     }
 
-    for (int i = 0; i < current.size(); i++) {
-        tokens.push_back(Token(current[i], current_line));
+    Token token(Tok::T_INT_CONST, current_line);
+    std::from_chars_result result;
+    if (has_dec) {
+        token.type = Tok::T_FLOAT_CONST;
+        result = std::from_chars(data + start, data + current_index, token.float_const);
     }
+    else
+        result = std::from_chars(data + start, data + current_index, token.int_const);
+
+    if (result.ec != std::errc()) {
+        lexer_error(current_line, "Numeric constant is out of range");
+        token.float_const = 0;
+        token.int_const = 0;
+    }
+
+    return token;
 }
 
-void Lexer::reset() {
-    current_type = 0;
-    current.clear();
+// The escape sequences are decoded by the parser, the token only points at the raw text.
+Token Lexer::string_const() {
+    const char* data = input->data();
+    uint32_t start = ++current_index;
+
+    Token token(Tok::T_STRING_CONST, current_line);
+    current_index = find_either(data, current_index, end_index, '"', '"', current_line);
+
+    if (current_index >= end_index) {
+        if (end_index < input->size())
+            cut_index = token_start;
+        else
+            lexer_error(token.line, "Unterminated string constant");
+    }
+
+    token.text = { start, current_index - start };
+    current_index++;
+    return token;
 }
 
-uint32_t Lexer::get_type(char c) {
-    if (isdigit(c))
-        return NUMERIC;
-    else if(is_identifier(c))
-        return IDENTIFIER;
-    return (!is_spec_char(c)) ? SYMBOL : 0;
+Token Lexer::char_const() {
+    uint32_t line = current_line;
+    current_index++;
+
+    char character = input->at(current_index);
+    if (character == '\\' && input->at(current_index + 1) == 'n') {
+        character = '\n';
+        current_index++;
+    }
+
+    // Skip over the character and the closing quote, a newline among them still starts a line.
+    for (uint32_t i = 0; i < 2; i++, current_index++)
+        current_line += (current_index < end_index && input->at(current_index) == '\n');
+    if (current_index > end_index && end_index < input->size())
+        cut_index = token_start;
+
+    Token token(Tok::T_CHAR_CONST, line);
+    token.char_const = character;
+    return token;
 }
 
-void Lexer::move() {
-    counter++;
+Token Lexer::symbol() {
+    char c = input->at(current_index);
+    int type = find_symbol(c, input->at(current_index + 1));
+    if (type) {
+        current_index += 2;
+        return Token(type, current_line);
+    }
+
     current_index++;
+    return Token(c, current_line);
+}
+
+void TokenStore::reserve(size_t count) {
+    kinds.reserve(count);
+    lines.reserve(count);
+    values.reserve(count / 2);
+}
+
+void TokenStore::push(const Token& token) {
+    kinds.push_back(token.type);
+    lines.push_back(token.line);
+    if (has_value(token.type))
+        values.push_back(token.value);
+}
+
+void TokenStore::push(const Token& token, uint32_t column) {
+    push(token);
+    columns.push_back(column);
+    if (token.type == Tok::T_STRING_CONST)
+        strings.push_back((uint32_t) values.size() - 1);
+}
+
+// The index of the first token on the line or after it.
+uint32_t TokenStore::first_on_line(uint32_t line) const {
+    return (uint32_t) (std::lower_bound(lines.begin(), lines.end(), line) - lines.begin());
+}
+
+// The kinds has_value is true for.
+static constexpr char VALUED_KINDS[] = { 
+    (char) Tok::T_IDENTIFIER, (char) Tok::T_STRING_CONST, (char) Tok::T_INT_CONST, (char) Tok::T_FLOAT_CONST, (char) Tok::T_CHAR_CONST 
+};
+
+// How many of the tokens from begin up to end have a value.
+uint32_t TokenStore::count_values(uint32_t begin, uint32_t end) const {
+    return count_any((const char*) kinds.data(), begin, end, VALUED_KINDS, sizeof(VALUED_KINDS));
+}
+
+template <typename T>
+static void replace_range(UninitializedVector<T>& into, size_t at, size_t count, const UninitializedVector<T>& with) {
+    if (with.size() > count)
+        into.insert(into.begin() + at + count, with.begin() + count, with.end());
+    else
+        into.erase(into.begin() + at + with.size(), into.begin() + at + count);
+    std::copy(with.begin(), with.begin() + std::min(count, with.size()), into.begin() + at);
 }
 
 /**
- * This is the run function. Will use the data from the filepath.
+ * Replaces the tokens from at on, removed.index of them holding removed.value values, with 
+ * the tokens of another store. Both have to keep the token columns.
+ */
+void TokenStore::splice(Cursor at, Cursor removed, const TokenStore& with) {
+    replace_range(kinds, at.index, removed.index, with.kinds);
+    replace_range(lines, at.index, removed.index, with.lines);
+    replace_range(columns, at.index, removed.index, with.columns);
+    replace_range(values, at.value, removed.value, with.values);
+
+    auto first = std::lower_bound(strings.begin(), strings.end(), at.value);
+    auto last = std::lower_bound(first, strings.end(), at.value + removed.value);
+    for (auto later = last; later != strings.end(); later++)
+        *later += (uint32_t) with.values.size() - removed.value;
+
+    first = strings.erase(first, last);
+    first = strings.insert(first, with.strings.begin(), with.strings.end());
+    for (size_t i = 0; i < with.strings.size(); i++)
+        first[i] += at.value;
+}
+
+/**
+ * Moves the tokens from the cursor on down by a number of lines, and the text of the string 
+ * constants among them by a number of bytes. Columns are left alone.
+ */
+void TokenStore::shift(Cursor from, int32_t line_delta, int32_t offset_delta) {
+    if (line_delta != 0) {
+        for (uint32_t i = from.index; i < (uint32_t) lines.size(); i++)
+            lines[i] += line_delta;
+    }
+
+    if (offset_delta == 0)
+        return;
+    for (auto string = std::lower_bound(strings.begin(), strings.end(), from.value); string != strings.end(); string++)
+        values[*string].text.offset += offset_delta;
+}
+
+void TokenStore::resize(size_t count, size_t value_count) {
+    kinds.resize(count);
+    lines.resize(count);
+    values.resize(value_count);
+}
+
+/**
+ * Copies every token of another store into this one starting at the given positions,
+ * which have to already exist (see resize). Line numbers are shifted by line_offset.
+ */
+void TokenStore::copy_from(const TokenStore& from, size_t index, size_t value_index, uint32_t line_offset) {
+    // std::copy since an empty store can have null data, which memcpy does not take.
+    std::copy(from.kinds.data(), from.kinds.data() + from.kinds.size(), kinds.data() + index);
+    std::copy(from.values.data(), from.values.data() + from.values.size(), values.data() + value_index);
+    for (size_t i = 0; i < from.lines.size(); i++)
+        lines[index + i] = from.lines[i] + line_offset;
+}
+
+/**
+ * Lexes the rest of the source into the token store. This is only needed when the
+ * whole token list is wanted (like for logging), the parser pulls tokens with next().
  */
 void Lexer::lex() {
-    bool num_has_dec = false;
-    
-    while (current_index < stream.size()) {
-        singleline_comment();
-        multiline_comment_beg();
-        if (current_type != SINGLE_LINE_COMMENT && current_type != MULTI_LINE_COMMENT) {
-            if (current_type == IDENTIFIER && !is_identifier(stream[current_index])) {
-                if (keywords.find(current) != keywords.end()) {
-                    tokens.push_back(Token(keywords[current], current_line));
-                    reset();
-                }
-                else if (!isdigit(stream[current_index])) {
-                    tokens.push_back(Token(Tok::T_IDENTIFIER, current_line));
-                
-                    tokens.back().identifier = new char[current.size()];
-                    strcpy(tokens.back().identifier, current.c_str());
-                    reset();
-                }
-            }
-            else if (!isdigit(stream[current_index]) && current_type == NUMERIC) {
-                if (stream[current_index] == '.' && !num_has_dec) {
-                    num_has_dec = true;
-                }
-                else {
-                    if (!num_has_dec) {
-                        tokens.push_back(Token(Tok::T_INT_CONST, current_line));
-                        tokens.back().int_const = atoi(current.c_str());
-                    }
-                    else if (num_has_dec) {
-                        tokens.push_back(Token(Tok::T_FLOAT_CONST, current_line));
-                        tokens.back().float_const = std::stof(current.c_str());
-                        num_has_dec = false;
-                    }
-
-                    reset();
-                }
-            }
-            else if (stream[current_index] == '"' && current_type == STRING) {
-                tokens.push_back(Token(Tok::T_STRING_CONST, current_line));
-                current.erase(0, 1);
-
-                for (int i = 0; i < current.size(); i++) {
-                    if (current[i] == '\\' && i != current.size() - 1) {
-                        if (current[i + 1] == 'n') {
-                            current.erase(i, 2);
-                            current.insert(i, "\n");
-                        }
-                        else if (current[i + 1] == '\\') {
-                            current.erase(i, 2);
-                            current.insert(i, "\\");
-                        }
-                    }
-                }
-
-                tokens.back().string = new char[current.length() + 1];
-                strcpy(tokens.back().string, current.c_str());
-
-                reset();
-                move();
-            }
-            else if (current_type == SYMBOL && (get_type(stream[current_index]) != SYMBOL || stream[current_index] == '\'')) {
-                create_sym_token();
-                reset();
+    Token token;
+    if (editable) {
+        // Roughly one token for every 4 bytes of source, saves growing the vector over and over.
+        tokens.reserve((end_index - current_index) / 4 + 1);
+
+        const char* data = input->data();
+        line_starts = { 0 };
+        for (uint32_t i = find_byte(data, 0, end_index, '\n'); i < end_index; i = find_byte(data, i + 1, end_index, '\n'))
+            line_starts.push_back(i + 1);
+
+        do {
+            uint32_t start;
+            token = scan_at((uint32_t) tokens.size(), start);
+            tokens.push(token, start - line_starts[token.line - 1]);
+        } while (token.type != Tok::T_EOF);
+    }
+    else {
+        // Every token but T_EOF takes at least a byte of the source, so the store is grown once
+        // for the most there can be and cut back after. Only the part filled in is ever touched.
+        size_t index = tokens.size();
+        size_t value_index = tokens.value_count();
+        size_t most = end_index - current_index + 1;
+        tokens.resize(index + most, value_index + most);
+        do {
+            token = scan();
+            tokens.set(index++, value_index, token);
+        } while (token.type != Tok::T_EOF);
+        tokens.resize(index, value_index);
+    }
+
+    lexed = true;
+}
+
+/**
+ * Scans the next token for a lexer that takes edits and gives back where it starts. The 
+ * errors found on the way are marked with index, the place of the token in the token list.
+ */
+Token Lexer::scan_at(uint32_t index, uint32_t& start) {
+    size_t reported = diagnostics.error_count();
+    Token token = scan();
+    start = (token.type == Tok::T_EOF) ? end_index : token_start;
+    if (diagnostics.error_count() != reported)
+        error_tokens.insert(error_tokens.end(), diagnostics.error_count() - reported, index);
+    return token;
+}
+
+/**
+ * Replaces count bytes of the source at offset with text and brings the token list up to date
+ * by lexing only the part of the source around the edit. Lexing picks up again at the last token 
+ * that starts before the edit, where the lexer is known to be outside of any comment or string,
+ * and stops at the first token past the edit that starts where a token started before it. The
+ * source from there on is unchanged and so are its tokens, they only move down. Tokens keep 
+ * their place as a line and column, so only the ones on the line the edit ends on have to move
+ * along the line. Needs editable to have been set before the source was lexed.
+ *
+ * @return TokenEdit Which tokens were replaced.
+ */
+TokenEdit Lexer::edit(uint32_t offset, uint32_t count, std::string_view text) {
+    offset = std::min(offset, source.size());
+    count = std::min(count, source.size() - offset);
+    source.replace(offset, count, text);
+    end_index = source.size();
+
+    int32_t delta = (int32_t) text.size() - (int32_t) count;
+    uint32_t total_lines = current_line;
+
+    uint32_t line = (uint32_t) (std::upper_bound(line_starts.begin(), line_starts.end(), offset) - line_starts.begin());
+    uint32_t first = tokens.first_on_line(line);
+    while (first < tokens.size() && tokens.line(first) == line && token_offset(first) < offset)
+        first++;
+
+    current_index = 0;
+    current_line = 1;
+    if (first > 0) {
+        first--;
+        current_index = token_offset(first);
+        current_line = tokens.line(first);
+    }
+    nested_comment = 0;
+
+    // The errors from the first token on are put aside, the ones past the tokens lexed again go back after them.
+    auto kept = std::lower_bound(error_tokens.begin(), error_tokens.end(), first);
+    std::vector<uint32_t> later(kept, error_tokens.end());
+    error_tokens.erase(kept, error_tokens.end());
+
+    // The new tokens hold where they start in the source as their column until the lines are updated.
+    TokenStore scanned;
+    uint32_t edit_end = offset + (uint32_t) text.size();
+    uint32_t old = first;
+    Token token;
+    while (true) {
+        uint32_t start;
+        token = scan_at(first + (uint32_t) scanned.size(), start);
+        if (start >= edit_end) {
+            uint32_t before = start - delta;
+            while (token_offset(old) < before)
+                old++;
+            if (token_offset(old) == before)
+                break;
+        }
+        scanned.push(token, start);
+    }
+
+    std::vector<uint32_t> moved;
+    for (uint32_t i = old; i < tokens.size() && tokens.line(i) == tokens.line(old); i++)
+        moved.push_back(token_offset(i) + delta);
+
+    // The lines that started in the replaced bytes are gone, every newline in text starts one and the lines after move along.
+    auto removed = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    auto removed_end = std::upper_bound(removed, line_starts.end(), offset + count);
+    for (auto start = removed_end; start != line_starts.end(); start++)
+        *start += delta;
+    std::vector<uint32_t> added;
+    for (size_t i = text.find('\n'); i != std::string_view::npos; i = text.find('\n', i + 1))
+        added.push_back(offset + (uint32_t) i + 1);
+    line_starts.insert(line_starts.erase(removed, removed_end), added.begin(), added.end());
+
+    for (uint32_t i = 0; i < scanned.size(); i++)
+        scanned.set_column(i, scanned.column(i) - line_starts[scanned.line(i) - 1]);
+
+    TokenEdit edit;
+    edit.first = { first, tokens.count_values(0, first) };
+    edit.removed = { old - first, tokens.count_values(first, old) };
+    edit.added = { (uint32_t) scanned.size(), (uint32_t) scanned.value_count() };
+    edit.lines = (int32_t) (token.line - tokens.line(old));
+
+    tokens.splice(edit.first, edit.removed, scanned);
+    tokens.shift({ first + edit.added.index, edit.first.value + edit.added.value }, edit.lines, delta);
+    for (uint32_t i = 0; i < moved.size(); i++) {
+        uint32_t index = first + edit.added.index + i;
+        tokens.set_column(index, moved[i] - line_starts[tokens.line(index) - 1]);
+    }
+
+    for (uint32_t at : later) {
+        if (at > old)
+            error_tokens.push_back(at - old + first + edit.added.index);
+    }
+
+    current_index = end_index;
+    current_line = total_lines + edit.lines;
+    return edit;
+}
+
+/**
+ * Hands out the next token. Tokens are served from the token store if lex() was 
+ * already run, otherwise they are scanned on demand so the full list never exists.
+ * Keeps returning T_EOF once the end is reached.
+ * 
+ * @return Token The next token.
+ */
+Token Lexer::next() {
+    if (lexed)
+        return tokens.read(cursor);
+    if (pipeline)
+        return next_pipelined();
+
+    return scan();
+}
+
+/**
+ * Starts lexing the rest of the source on its own thread. The tokens are passed to next() in 
+ * batches through a lock free ring, so the parser can work on one part of the file while the
+ * next part is still being lexed. Errors are reported by next() in the same order as they
+ * would be when lexing on demand.
+ */
+void Lexer::lex_pipelined() {
+    pipeline.reset(new Pipeline);
+    defer_errors = true;
+    pipeline->thread = std::thread(&Lexer::produce, this);
+}
+
+// Runs on the lexer thread, fills batches until the end of the source.
+void Lexer::produce() {
+    Pipeline& pipe = *pipeline;
+
+    bool done = false;
+    while (!done) {
+        TokenBatch* batch;
+        while (!(batch = pipe.ring.reserve())) {
+            if (pipe.stopping.load(std::memory_order_relaxed))
+                return;
+            std::this_thread::yield();
+        }
+
+        batch->count = 0;
+        batch->errors.clear();
+        while (batch->count < TokenBatch::SIZE && !done) {
+            Token token = scan();
+            if (!errors.empty()) {
+                for (auto& error : errors)
+                    batch->errors.push_back({ batch->count, error });
+                errors.clear();
             }
-            if (!is_spec_char(stream[current_index]) || current_type == STRING) {
-                current.push_back(stream[current_index]);
-                if (current.size() == 1) {
-                    if (current[0] == '\'') {
-                        move();
-
-                        char character = stream[current_index];
-                        if (stream[current_index] == '\\') {
-                            if (stream[current_index + 1] == 'n') {
-                                character = '\n';
-                                move();
-                            }
-                        }
-
-                        tokens.push_back(Token(Tok::T_CHAR_CONST, current_line));
-                        tokens.back().char_const = character;
-
-                        reset();
-                        move();
-                    }
-                    else {
-                        current_type = get_type(stream[current_index]);
-
-                        if (current_type == SYMBOL) {
-                            if (stream[current_index] == '"') 
-                                current_type = STRING;
-                        }
-                    }
-                }
-            }      
+
+            batch->tokens[batch->count++] = token;
+            done = (token.type == Tok::T_EOF);
+        }
+
+        pipe.ring.publish();
+    }
+}
+
+Token Lexer::next_pipelined() {
+    Pipeline& pipe = *pipeline;
+
+    if (pipe.batch && pipe.index == pipe.batch->count) {
+        pipe.ring.pop();
+        pipe.batch = nullptr;
+    }
+
+    if (!pipe.batch) {
+        while (!(pipe.batch = pipe.ring.front()))
+            std::this_thread::yield();
+        pipe.index = 0;
+        pipe.error_index = 0;
+    }
+
+    auto& batch_errors = pipe.batch->errors;
+    for (; pipe.error_index < batch_errors.size() && batch_errors[pipe.error_index].at == pipe.index; pipe.error_index++) {
+        LexerError& error = batch_errors[pipe.error_index].error;
+        diagnostics.error(filepath, error.line, error.msg);
+    }
+
+    // The last token is T_EOF, it is handed out again on every call after that and the
+    // lexer thread is done by then.
+    Token token = pipe.batch->tokens[pipe.index];
+    if (token.type != Tok::T_EOF)
+        pipe.index++;
+    else if (pipe.thread.joinable())
+        pipe.thread.join();
+    return token;
+}
+
+/**
+ * Lexes the chunk this lexer was created for. A token cut off by the end of the chunk
+ * is left out, cut_index then tells where it started.
+ */
+void Lexer::lex_range() {
+    Token token = scan();
+    while (token.type != Tok::T_EOF && cut_index == NO_CUT) {
+        tokens.push(token);
+        token = scan();
+    }
+
+    if (cut_index != NO_CUT) 
+        current_line = token.line;
+}
+
+/**
+ * Lexes the rest of the source on the thread pool. The source is split after newlines into
+ * chunks that are lexed independently as if each started outside of any comment or string. 
+ * The chunks are then stitched back together in order, and a chunk that really started inside 
+ * a multi-line comment or a string is lexed again from the correct state. The result is the 
+ * same token list (and errors) as lex() would give.
+ * 
+ * @param uint32_t The number of chunks to split the source into.
+ */
+void Lexer::lex_parallel(uint32_t chunk_count) {
+    const char* data = input->data();
+    uint32_t begin = current_index;
+
+    std::vector<uint32_t> bounds = { begin };
+    for (uint32_t i = 1; i < chunk_count; i++) {
+        uint32_t bound = begin + (uint32_t) ((uint64_t) (end_index - begin) * i / chunk_count);
+        if (bound <= bounds.back())
+            bound = bounds.back() + 1;
+        while (bound < end_index && data[bound - 1] != '\n')
+            bound++;
+
+        if (bound < end_index)
+            bounds.push_back(bound);
+    }
+    bounds.push_back(end_index);
+
+    // A lexer that takes edits needs the columns of its tokens, which the chunks do not keep.
+    uint32_t count = (uint32_t) bounds.size() - 1;
+    if (count < 2 || editable) {
+        lex();
+        return;
+    }
+
+    std::vector<std::unique_ptr<Lexer>> chunks(count);
+    thread_pool().parallel_for(count, [&](uint32_t i) {
+        chunks[i].reset(new Lexer(input, filepath, bounds[i], bounds[i + 1], (i == 0) ? nested_comment : 0));
+        chunks[i]->tokens.reserve((bounds[i + 1] - bounds[i]) / 4 + 1);
+        chunks[i]->lex_range();
+    });
+
+    // Where and in what state lexing has to pick up again when a chunk did not end cleanly.
+    bool clean = true;
+    uint32_t resume_index = 0;
+    uint32_t resume_comment = 0;
+
+    // The first line and the position in the token list of every chunk.
+    std::vector<uint32_t> first_lines(count);
+    std::vector<size_t> offsets(count);
+    std::vector<size_t> value_offsets(count);
+    size_t total = tokens.size();
+    size_t total_values = tokens.value_count();
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!clean) {
+            chunks[i].reset(new Lexer(input, filepath, resume_index, bounds[i + 1], resume_comment));
+            chunks[i]->lex_range();
         }
-        multiline_comment_end();
-        newline();  //Check for newline.
-        move();
+        Lexer* chunk = chunks[i].get();
+
+        for (auto& error : chunk->errors)
+            diagnostics.error(filepath, current_line + error.line, error.msg);
+
+        first_lines[i] = current_line;
+        offsets[i] = total;
+        value_offsets[i] = total_values;
+        total += chunk->tokens.size();
+        total_values += chunk->tokens.value_count();
+
+        current_line += chunk->current_line;
+        clean = (chunk->cut_index == NO_CUT && chunk->nested_comment == 0);
+        resume_index = (chunk->cut_index != NO_CUT) ? chunk->cut_index : bounds[i + 1];
+        resume_comment = chunk->nested_comment;
     }
-    tokens.push_back(Token(Tok::T_EOF, current_line));
+
+    tokens.resize(total, total_values);
+    thread_pool().parallel_for(count, [&](uint32_t i) {
+        tokens.copy_from(chunks[i]->tokens, offsets[i], value_offsets[i], first_lines[i]);
+        chunks[i].reset();
+    });
+
+    current_index = end_index;
+    nested_comment = 0;
+    tokens.push(Token(Tok::T_EOF, current_line));
+    lexed = true;
 }
 
 /**
  * Will log all the tokens collected during analysis.
  */
 void Lexer::log() {
-    for (int i = 0; i < tokens.size(); i++) 
-        log_token(tokens[i], i);
+    TokenStore::Cursor at;
+    for (uint32_t i = 0; i < tokens.size(); i++) {
+        Token token = tokens.read(at);
+        log_token(token, i);
+    }
 }
 
 /**
@@ -299,15 +940,17 @@ void Lexer::print_token(Token& token) {
     log_keywords_symbols(token.type);
 
     switch (token.type) {
-    case Tok::T_IDENTIFIER: 
-        printf("%s", token.identifier);
+    case Tok::T_IDENTIFIER: {
+        std::string_view name = symbol_name(token.symbol);
+        printf("%.*s", (int) name.size(), name.data());
+        break;
+    }
+    case Tok::T_STRING_CONST: 
+        printf("%.*s", (int) token.text.length, input->data() + token.text.offset);
         break;
     case Tok::T_EOF: 
         printf("EOF");
         break;
-    case Tok::T_STRING_CONST: 
-        printf("%s", token.string);
-        break;
     case Tok::T_CHAR_CONST: 
         printf("%c", token.char_const);
         break;
@@ -352,14 +995,6 @@ void Lexer::log_keywords_symbols(int type) {
 }
 
 void Lexer::load() {
-    struct stat sb{};
-
-    FILE* input_file = fopen(filepath, "r");
-    if (!input_file)
+    if (!source.open(filepath))
         fatal_error("Unable to open file '%s'.\n", filepath);
-
-    stat(filepath, &sb);
-    stream.resize(sb.st_size);
-    fread(const_cast<char*>(stream.data()), sb.st_size, 1, input_file);
-    fclose(input_file);
 }
\ No newline at end of file
@@ -22,34 +22,376 @@
 #include "bench.h"
 #include "err.h"
 #include "interpreter.h"
+#include "thread_pool.h"
+#include "scan.h"
+#include "flatten.h"
+#include "cache.h"
+#include "module.h"
+#include "resolver.h"
+#include "checker.h"
+#include "optimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
 
 // If USE_VM is defined, YAPL will use the VM otherwise it will use the interpreter.
 #ifdef USE_VM
     #include "vm.h"
 #endif
 
+// Times the whole front end over the file with the lexer and parser taking turns on one thread
+// and then with the lexer running ahead on its own thread.
+static void bench_pipeline(const char* filepath) {
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        begin_debug_benchmark();
+        Lexer lex(filepath);
+        if (pipelined)
+            lex.lex_pipelined();
+
+        Parser parser(&lex);
+        parser.parse();
+        end_debug_benchmark(pipelined ? "pipelined front end" : "serial front end");
+    }
+}
+
+// Lexes the file once and then times parsing its tokens a few times over.
+static void bench_parse(const char* filepath) {
+    Lexer lex(filepath);
+    lex.lex();
+
+    float best = 0.0f;
+    for (int run = 0; run < 5; run++) {
+        lex.rewind();
+        begin_debug_benchmark();
+        Parser parser(&lex);
+        parser.parse();
+        float time = end_debug_benchmark("parser");
+        best = (run == 0 || time < best) ? time : best;
+    }
+    printf("best parse time of %zu tokens is %f ms.\n", lex.fetch_tokens()->size(), best);
+}
+
+// Runs the program with every call left as it is and then with small functions inlined, timing
+// only the running of it.
+static void bench_inline(const char* filepath) {
+    for (int inlined = 0; inlined < 2; inlined++) {
+        Lexer lex(filepath);
+        Parser parser(&lex);
+        parser.parse();
+        Ast_TranslationUnit* unit = parser.translation_unit();
+        Resolver resolver(lex.diagnostics);
+        resolver.resolve(unit);
+        Checker checker(lex.diagnostics);
+        checker.check(unit);
+        lex.diagnostics.flush();
+
+        OptimizeOptions options;
+        if (!inlined)
+            options.inline_size = 0;
+        OptimizeStats stats = optimize_translation_unit(unit, options);
+        printf("inlined %u calls...\n", stats.inlined);
+
+        Interpreter interpreter;
+        begin_debug_benchmark();
+        interpreter.interpret(unit);
+        end_debug_benchmark(inlined ? "interpreter with inlining" : "interpreter without inlining");
+    }
+}
+
+// The files the program imports are loaded and linked in ahead of it.
+static void load_modules(ModuleGraph& modules) {
+    begin_debug_benchmark();
+    modules.load();
+    if (modules.imported() > 0) {
+        end_debug_benchmark("modules");
+        printf("loaded %u imported modules (%u from the cache)...\n", modules.imported(), modules.from_cache());
+    }
+}
+
+// The imports are loaded again on every run so changes to them are seen too. Linking replaces the
+// declarations of the unit, the parser's own are put back afterwards for the next edit.
+static void run_if_clean(Lexer& lex, Parser& parser) {
+    if (parser.current_errors() > 0)
+        return;
+    Ast_TranslationUnit* unit = parser.translation_unit();
+    Ast_List<Ast_Decleration*> parsed = unit->declerations;
+    ModuleGraph modules(lex, unit);
+    load_modules(modules);
+
+    Resolver resolver(lex.diagnostics);
+    resolver.resolve(unit);
+    Checker checker(lex.diagnostics);
+    checker.check(unit);
+    lex.diagnostics.flush();
+
+    Interpreter interpreter;
+    interpreter.interpret(unit);
+    unit->declerations = parsed;
+}
+
+// How many times bench_edit adds a line and takes it out again before adding it for good.
+#define NEWLINE_EDITS 50
+
+// Retypes the line in the middle of the file one character at a time, first deleting it from the end
+// and then typing it back in, bringing the tokens and the tree up to date after every keystroke. Then
+// adds a line before it and removes it a few times, leaving it in at the end. The program is run
+// afterwards and should do what it did before, with the lines after that one a line further down.
+static void bench_edit(const char* filepath) {
+    Lexer lex(filepath);
+    lex.editable = true;
+    lex.lex();
+    Parser parser(&lex);
+    parser.set_incremental(true);
+    parser.parse();
+
+    // The first line from the middle on that is not empty.
+    std::string_view source(lex.source.data(), lex.source.size());
+    uint32_t line = 1;
+    uint32_t begin = 0;
+    for (size_t next; begin < source.size() && (line < lex.lines() / 2 || source[begin] == '\n'); line++) {
+        if ((next = source.find('\n', begin)) == std::string_view::npos)
+            break;
+        begin = (uint32_t) next + 1;
+    }
+    std::string text(source.substr(begin, source.find('\n', begin) - begin));
+
+    float total = 0.0f;
+    float worst = 0.0f;
+    uint32_t runs = 0;
+    for (uint32_t i = 0; i < 2 * text.size(); i++) {
+        begin_debug_benchmark();
+        TokenEdit edit = (i < text.size()) ? lex.edit(begin + (uint32_t) (text.size() - i - 1), 1, "") : 
+                                             lex.edit(begin + (uint32_t) (i - text.size()), 0, std::string_view(text).substr(i - text.size(), 1));
+        runs += parser.reparse(edit);
+        float time = debug_benchmark_time();
+
+        total += time;
+        worst = (time > worst) ? time : worst;
+        lex.diagnostics.discard();
+    }
+
+    // Then presses enter at the start of the line and takes it back, moving everything after it.
+    float moved = 0.0f;
+    for (uint32_t i = 0; i < 2 * NEWLINE_EDITS + 1; i++) {
+        begin_debug_benchmark();
+        TokenEdit edit = (i % 2 == 0) ? lex.edit(begin, 0, "\n") : lex.edit(begin, 1, "");
+        runs += parser.reparse(edit);
+        moved += debug_benchmark_time();
+        lex.diagnostics.discard();
+    }
+
+    printf("retyped line %u of %u (%zu characters), parsing %u top level declarations again...\n", 
+        line, lex.lines(), text.size(), runs);
+    printf("reparse time per keystroke is %f ms on average and %f ms at worst.\n", 
+        text.empty() ? 0.0f : total / (2 * text.size()), worst);
+    printf("reparse time per added or removed line is %f ms on average.\n", moved / (2 * NEWLINE_EDITS + 1));
+    run_if_clean(lex, parser);
+}
+
+// Runs the program and then again every time the file is saved, lexing and parsing only what changed.
+// The change is taken as one edit from the first byte that differs to the last one.
+static void watch(const char* filepath) {
+    Lexer lex(filepath);
+    lex.editable = true;
+    lex.lex();
+    Parser parser(&lex);
+    parser.set_incremental(true);
+    parser.parse();
+    run_if_clean(lex, parser);
+
+    std::error_code error;
+    auto written = std::filesystem::last_write_time(filepath, error);
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = std::filesystem::last_write_time(filepath, error);
+        if (error || now == written)
+            continue;
+        written = now;
+
+        std::ifstream file(filepath, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::string_view was(lex.source.data(), lex.source.size());
+        if (!file.good() && !file.eof())
+            continue;
+
+        size_t same = std::mismatch(was.begin(), was.end(), text.begin(), text.end()).first - was.begin();
+        size_t tail = 0;
+        while (tail < was.size() - same && tail < text.size() - same && was[was.size() - tail - 1] == text[text.size() - tail - 1])
+            tail++;
+        if (same == was.size() && same == text.size())
+            continue;
+
+        printf("%s changed...\n", filepath);
+        begin_debug_benchmark();
+        TokenEdit edit = lex.edit((uint32_t) same, (uint32_t) (was.size() - same - tail), std::string_view(text).substr(same, text.size() - same - tail));
+        uint32_t runs = parser.reparse(edit);
+        end_debug_benchmark("incremental front end");
+        printf("parsed %u top level declarations again...\n", runs);
+
+        lex.diagnostics.flush();
+        run_if_clean(lex, parser);
+        fflush(stdout);
+    }
+}
+
 int main(int argc, char* argv[]) {
     printf("USING YAPL VERSION %d.%d\n", YAPL_VERSION_MAJOR, YAPL_VERSION_MINOR);
     if (!argv[1])
         fatal_error("no input file found.\n");
+
+    bool log = false;
+    bool pipeline = false;
+    bool flat_ast = false;
+    bool lazy_functions = false;
+    bool optimize = true;
+    bool optimize_stats = false;
+    OptimizeOptions optimize_options;
+    uint32_t parse_partitions = 0;
+    const char* cache_dir = nullptr;
+    uint32_t lex_chunks = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-log") == 0)
+            log = true;
+        else if (strcmp(argv[i], "-parallel-lex") == 0)
+            lex_chunks = thread_pool().size() * 4;
+        else if (strncmp(argv[i], "-parallel-lex=", 14) == 0)
+            lex_chunks = (uint32_t) atoi(argv[i] + 14);
+        else if (strcmp(argv[i], "-pipeline") == 0)
+            pipeline = true;
+        else if (strcmp(argv[i], "-flat-ast") == 0)
+            flat_ast = true;
+        else if (strcmp(argv[i], "-lazy-funcs") == 0)
+            lazy_functions = true;
+        else if (strcmp(argv[i], "-no-opt") == 0)
+            optimize = false;
+        else if (strcmp(argv[i], "-opt-stats") == 0)
+            optimize_stats = true;
+        else if (strncmp(argv[i], "-inline=", 8) == 0)
+            optimize_options.inline_size = (uint32_t) atoi(argv[i] + 8);
+        else if (strcmp(argv[i], "-parallel-parse") == 0)
+            parse_partitions = thread_pool().size() * 4;
+        else if (strncmp(argv[i], "-parallel-parse=", 16) == 0)
+            parse_partitions = (uint32_t) atoi(argv[i] + 16);
+        else if (strcmp(argv[i], "-cache") == 0)
+            cache_dir = ".yaplc";
+        else if (strncmp(argv[i], "-cache=", 7) == 0)
+            cache_dir = argv[i] + 7;
+        else if (strcmp(argv[i], "-bench-pipeline") == 0) {
+            bench_pipeline(argv[1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-bench-parse") == 0) {
+            bench_parse(argv[1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-bench-inline") == 0) {
+            bench_inline(argv[1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-bench-edit") == 0) {
+            bench_edit(argv[1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-watch") == 0) {
+            watch(argv[1]);
+            return 0;
+        }
+        else
+            report_warning("unknown option '%s'.\n", argv[i]);
+    }
+
     Lexer lex(argv[1]);
 
-    printf("started lexing...\n");
-    begin_debug_benchmark();
-    lex.lex();
-    if (argv[2] && strcmp(argv[2], "-log") == 0)
-        lex.log();
-    end_debug_benchmark("lexer");
-    printf("finished lexing %d lines of code...\n", lex.lines());
-    
-    Parser parser(&lex);
-    parser.parse();
+    // On a cache hit the program is read back already parsed and the front end is skipped.
+    std::unique_ptr<Ast_TranslationUnit> cached;
+    std::unique_ptr<Parser> parser;
+    if (cache_dir) {
+        begin_debug_benchmark();
+        cached.reset(load_program_cache(cache_dir, lex));
+        end_debug_benchmark("cache lookup");
+    }
+
+    Ast_TranslationUnit* unit = nullptr;
+    if (cached) {
+        unit = cached.get();
+        printf("loaded the parsed program from the cache...\n");
+    }
+    else {
+        // Logging, the parallel lexer and parser and lazy function bodies need the whole token list 
+        // up front, otherwise the parser pulls tokens as it goes.
+        if (lex_chunks > 1 || log || lazy_functions || parse_partitions > 1) {
+            printf("started lexing (%s scanning)...\n", scan_isa());
+            begin_debug_benchmark();
+            if (lex_chunks > 1)
+                lex.lex_parallel(lex_chunks);
+            else
+                lex.lex();
+            end_debug_benchmark("lexer");
+            printf("finished lexing %d lines of code (%zu tokens)...\n", lex.lines(), lex.fetch_tokens()->size());
+
+            if (log)
+                lex.log();
+        }
+        else if (pipeline)
+            lex.lex_pipelined();
+
+        printf("started parsing...\n");
+        begin_debug_benchmark();
+        parser.reset(new Parser(&lex));
+        parser->set_lazy_functions(lazy_functions);
+        if (parse_partitions > 1)
+            parser->parse_parallel(parse_partitions);
+        else
+            parser->parse();
+        end_debug_benchmark("front end");
+        printf("finished parsing %d lines of code...\n", lex.lines());
+        if (lazy_functions)
+            printf("skipped %u function bodies until they are called...\n", parser->skipped_bodies());
+
+        unit = parser->translation_unit();
+        // A program with errors is not cached, the errors have to be reported on every run.
+        if (cache_dir && lex.diagnostics.error_count() == 0 && save_program_cache(cache_dir, lex, unit))
+            printf("wrote the parsed program to the cache...\n");
+    }
+
+    ModuleGraph modules(lex, unit, cache_dir);
+    load_modules(modules);
+
+    // Every variable gets its slot and every expression its type before the program is flattened and run.
+    Resolver resolver(lex.diagnostics);
+    resolver.resolve(unit);
+    Checker checker(lex.diagnostics);
+    checker.check(unit);
+    lex.diagnostics.flush();
+
+    if (optimize) {
+        OptimizeStats stats = optimize_translation_unit(unit, optimize_options);
+        if (optimize_stats)
+            printf("folded %u constant expressions, propagated %u constants, inlined %u calls, hoisted %u loop invariants, "
+                "made %u increments, reduced %u induction products, shared %u common subexpressions and eliminated %u dead nodes...\n",
+                stats.folded, stats.propagated, stats.inlined, stats.hoisted, stats.incremented, stats.reduced, stats.shared, stats.eliminated);
+        if (optimize_stats) {
+            for (auto& note : stats.notes)
+                printf("%s on line %u of '%s'...\n", note.what, note.line, note.file);
+        }
+    }
+
+    if (flat_ast) {
+        FlattenStats stats = flatten_translation_unit(unit);
+        printf("flattened %u expression nodes into %zu bytes (%zu bytes as tree nodes)...\n", 
+            stats.nodes, unit->flat.bytes(), stats.tree_bytes);
+    }
 
 #ifdef USE_VM
     vm::run();
 #else
     Interpreter interpreter;
-    interpreter.interpret(parser.translation_unit());
+    interpreter.interpret(unit);
 #endif
 
     return 0;
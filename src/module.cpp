@@ -0,0 +1,189 @@
+/**
+ * @file module.cpp
+ * @author strah19
+ * @date July 18 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Finds, loads and links the files a program imports.
+ */
+
+#include "module.h"
+#include "cache.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+
+//error messages
+#define IMPORT_NOT_FOUND "Imported file not found"
+#define FUNCTION_REDEFINED "Function is defined in more than one module"
+#define VARIABLE_REDEFINED "Variable is defined in more than one module"
+
+namespace fs = std::filesystem;
+
+// The full path of a file with the links in it followed, as far as they exist.
+static std::string module_key(const fs::path& path) {
+    std::error_code error;
+    fs::path full = fs::weakly_canonical(path, error);
+    return (error ? path.lexically_normal() : full).string();
+}
+
+ModuleGraph::ModuleGraph(Lexer& lexer, Ast_TranslationUnit* unit, const char* cache_dir) : cache_dir(cache_dir) {
+    Module* program = new Module;
+    program->path = lexer.file();
+    program->key = module_key(program->path);
+    program->lexer = &lexer;
+    program->unit = unit;
+
+    modules.emplace_back(program);
+    by_key.emplace(program->key, program);
+}
+
+/**
+ * Goes through the imports one round at a time. The imports of the modules parsed in a round
+ * that were not seen before make up the next round, which is parsed all at once on the pool.
+ */
+void ModuleGraph::load() {
+    std::vector<Module*> round = { modules[0].get() };
+    while (!round.empty()) {
+        std::vector<Module*> next;
+        for (Module* module : round) {
+            for (auto decleration : module->unit->declerations) {
+                if (decleration->type != AST_IMPORT)
+                    continue;
+
+                size_t known = modules.size();
+                Module* imported = find(module, AST_CAST(Ast_ImportDecleration, decleration));
+                if (!imported)
+                    continue;
+                module->imports.push_back(imported);
+                if (modules.size() > known)
+                    next.push_back(imported);
+            }
+        }
+
+        thread_pool().parallel_for((uint32_t) next.size(), [&](uint32_t i) {
+            parse(next[i]);
+        });
+        for (Module* module : next)
+            cached += module->from_cache;
+        round = std::move(next);
+    }
+
+    if (modules.size() > 1)
+        link();
+    for (auto& module : modules)
+        module->lexer->diagnostics.release();
+}
+
+/**
+ * Lexes and parses a module on a thread of the pool, or reads it from the cache. Its errors are
+ * held in its lexer's sink until the whole program is loaded.
+ */
+void ModuleGraph::parse(Module* module) {
+    module->own_lexer.reset(new Lexer(module->path.c_str()));
+    module->lexer = module->own_lexer.get();
+    module->lexer->diagnostics.hold();
+
+    if (cache_dir) {
+        module->cached.reset(load_program_cache(cache_dir, *module->lexer));
+        module->from_cache = module->cached != nullptr;
+        if (module->from_cache) {
+            module->unit = module->cached.get();
+            return;
+        }
+    }
+
+    module->lexer->lex();
+    module->parser.reset(new Parser(module->lexer));
+    module->parser->parse();
+    module->unit = module->parser->translation_unit();
+
+    if (cache_dir && module->lexer->diagnostics.error_count() == 0)
+        save_program_cache(cache_dir, *module->lexer, module->unit);
+}
+
+/**
+ * The module of an import, made the first time its file is imported. The path of an import is
+ * taken from the directory of the file it is in.
+ *
+ * @return Module* The module, or nullptr if there is no such file.
+ */
+Module* ModuleGraph::find(Module* importer, Ast_ImportDecleration* import) {
+    fs::path path = (fs::path(importer->path).parent_path() / import->path).lexically_normal();
+    std::string key = module_key(path);
+    auto found = by_key.find(key);
+    if (found != by_key.end())
+        return found->second;
+
+    std::error_code error;
+    if (!fs::is_regular_file(path, error)) {
+        importer->lexer->diagnostics.error(import->file(), import->source_line(), IMPORT_NOT_FOUND);
+        return nullptr;
+    }
+
+    Module* module = new Module;
+    module->path = path.string();
+    module->key = key;
+    module->index = (uint32_t) modules.size();
+
+    modules.emplace_back(module);
+    by_key.emplace(key, module);
+    return module;
+}
+
+/**
+ * Puts a module after everything it imports, depth first. A module that is already on its way
+ * in is skipped, so in an import cycle the module that closes it goes first.
+ */
+void ModuleGraph::order(Module* module, std::vector<Module*>& ordered, std::vector<uint8_t>& visited) {
+    if (visited[module->index])
+        return;
+    visited[module->index] = true;
+
+    for (Module* imported : module->imports)
+        order(imported, ordered, visited);
+    ordered.push_back(module);
+}
+
+/**
+ * Makes the declarations of the program's unit those of every module, each module after the
+ * ones it imports, without the imports themselves. The names defined at the top level are
+ * gathered across the modules here, once, and a name that two modules define is reported at
+ * the second one rather than when the program gets to it.
+ */
+void ModuleGraph::link() {
+    std::vector<Module*> ordered;
+    std::vector<uint8_t> visited(modules.size(), false);
+    order(modules[0].get(), ordered, visited);
+
+    Ast_TranslationUnit* program = modules[0]->unit;
+    Ast_List<Ast_Decleration*> declerations;
+    std::unordered_map<SymbolId, Module*> defined;
+    for (Module* module : ordered) {
+        for (auto decleration : module->unit->declerations) {
+            SymbolId ident = SYMBOL_NONE;
+            if (decleration->type == AST_IMPORT)
+                continue;
+            else if (decleration->type == AST_FUNC_DECLERATION)
+                ident = AST_CAST(Ast_FuncDecleration, decleration)->ident;
+            else if (decleration->type == AST_VAR_DECLERATION)
+                ident = AST_CAST(Ast_VarDecleration, decleration)->ident;
+
+            if (ident != SYMBOL_NONE && defined.emplace(ident, module).first->second != module) {
+                module->lexer->diagnostics.error(decleration->file(), decleration->source_line(),
+                    (decleration->type == AST_FUNC_DECLERATION) ? FUNCTION_REDEFINED : VARIABLE_REDEFINED);
+            }
+            declerations.push_back(program->arena, decleration);
+        }
+    }
+
+    program->declerations = declerations;
+}
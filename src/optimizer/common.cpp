@@ -0,0 +1,280 @@
+/**
+ * @file common.cpp
+ * @author strah19
+ * @date July 29 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Works out an expression repeated in a block once and reuses the value.
+ */
+
+#include "optimizer.h"
+#include "walker.h"
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Goes over the statements of each block in the order they run, numbering the expressions made of
+// operators, casts, literals and variables that the checker gave a type by what they work out. A
+// value is available from where it is first worked out until something writes one of the variables
+// it reads, and a use of an available value becomes an Ast_CommonExpression that reads the slot the
+// first one kept it in.
+//
+// Every operand of an expression is worked out, so the first one has always run before the uses in
+// the same run of statements. A run ends at anything that does not run straight through: a scope,
+// a branch, a loop or a return. A call or an inlined call can write anything, so nothing is
+// available after one.
+class Numberer : public Walker {
+public:
+    Numberer(Ast_TranslationUnit* unit, OptimizeStats& stats) : Walker(unit), stats(stats) { }
+private:
+    struct Value {
+        std::vector<Ast_Expression**> uses; // the first works it out
+        std::unordered_set<Ast_VarDecleration*> reads;
+    };
+
+    // The statements going over since the last place a run ended.
+    struct Run {
+        std::vector<Value> values;
+        std::unordered_map<std::string, size_t> available;
+    };
+
+    void block(Ast_List<Ast_Decleration*>& declerations) override;
+    void decleration(Ast_Decleration*& decleration) override;
+    void expression(Ast_Expression*& expression) override;
+    void condition(Ast_Expression*& condition);
+    void write(Ast_VarDecleration* variable);
+    void end();
+
+    OptimizeStats& stats;
+
+    Run* run = nullptr; // of the block being gone over
+};
+
+void eliminate_common_subexpressions(Ast_TranslationUnit* unit, OptimizeStats& stats) {
+    Numberer numberer(unit, stats);
+    numberer.program(unit->declerations);
+}
+
+void Numberer::block(Ast_List<Ast_Decleration*>& declerations) {
+    Run* outer = run;
+    Run inner;
+    run = &inner;
+    Walker::block(declerations);
+    end();
+    run = outer;
+}
+
+// A condition that does not always run right after the statements before it is a run of its own.
+void Numberer::condition(Ast_Expression*& condition) {
+    Run* outer = run;
+    Run own;
+    run = &own;
+    expression(condition);
+    end();
+    run = outer;
+}
+
+void Numberer::decleration(Ast_Decleration*& decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+    case AST_PRINT:
+        walk(decleration);
+        break;
+    case AST_VAR_DECLERATION:
+        walk(decleration);
+        write(AST_CAST(Ast_VarDecleration, decleration));
+        break;
+    case AST_INCREMENT:
+        write(AST_CAST(Ast_Increment, decleration)->address.variable);
+        break;
+    case AST_RETURN:
+        walk(decleration);
+        end();
+        break;
+    case AST_IF: {
+        // The first condition runs right after what comes before it, the ones after it might not run.
+        auto conditional = AST_CAST(Ast_ConditionalStatement, decleration);
+        expression(conditional->condition);
+        end();
+        for (; conditional; conditional = conditional->next) {
+            if (conditional != decleration)
+                this->condition(conditional->condition);
+            if (conditional->scope)
+                block(conditional->scope->declerations);
+        }
+        break;
+    }
+    case AST_WHILE: {
+        end();
+        auto loop = AST_CAST(Ast_WhileLoop, decleration);
+        condition(loop->condition);
+        if (loop->scope)
+            block(loop->scope->declerations);
+        break;
+    }
+    default:
+        end();
+        walk(decleration);
+        break;
+    }
+}
+
+static void append(std::string& key, const void* bytes, size_t size) {
+    key.append(static_cast<const char*>(bytes), size);
+}
+
+// Works out a key that is the same for expressions that work out the same value from the same
+// variables, false if the expression can not be shared.
+static bool number(Ast_Expression* expression, std::string& key, std::unordered_set<Ast_VarDecleration*>& reads) {
+    if (expression->type == AST_BINARY) {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        if (binary->value_type == AST_TYPE_NONE)
+            return false;
+        key += 'b';
+        append(key, &binary->op, sizeof(binary->op));
+        return number(binary->left, key, reads) && number(binary->right, key, reads);
+    }
+    if (expression->type == AST_UNARY) {
+        auto unary = AST_CAST(Ast_UnaryExpression, expression);
+        if (unary->value_type == AST_TYPE_NONE)
+            return false;
+        key += 'u';
+        append(key, &unary->op, sizeof(unary->op));
+        return number(unary->next, key, reads);
+    }
+    if (expression->type != AST_PRIMARY)
+        return false;
+
+    auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+    switch (primary->type_value) {
+    case AST_NESTED:
+        return number(primary->nested, key, reads);
+    case AST_CAST:
+        if (primary->value_type == AST_TYPE_NONE)
+            return false;
+        key += 'k';
+        append(key, &primary->cast.cast_type, sizeof(primary->cast.cast_type));
+        return number(primary->cast.expression, key, reads);
+    case AST_ID:
+        if (!primary->address.variable)
+            return false;
+        key += 'v';
+        append(key, &primary->address.variable, sizeof(primary->address.variable));
+        reads.insert(primary->address.variable);
+        return true;
+    case AST_INT:
+        key += 'i';
+        append(key, &primary->int_const, sizeof(primary->int_const));
+        return true;
+    case AST_FLOAT:
+        key += 'f';
+        append(key, &primary->float_const, sizeof(primary->float_const));
+        return true;
+    case AST_CHAR:
+        key += 'c';
+        append(key, &primary->char_const, sizeof(primary->char_const));
+        return true;
+    case AST_BOOLEAN:
+        key += 'z';
+        append(key, &primary->boolean, sizeof(primary->boolean));
+        return true;
+    case AST_STRING:
+        key += 's';
+        append(key, primary->string, strlen(primary->string) + 1);
+        return true;
+    }
+    return false;
+}
+
+// Goes over the parts of an expression in the order the interpreter works them out.
+void Numberer::expression(Ast_Expression*& expression) {
+    if (!expression)
+        return;
+
+    // A variable or a unary operator on one is as quick to work out as reading a slot.
+    bool shareable = expression->type == AST_BINARY || expression->type == AST_UNARY ||
+        (expression->type == AST_PRIMARY && AST_CAST(Ast_PrimaryExpression, expression)->type_value == AST_CAST);
+    std::string key;
+    std::unordered_set<Ast_VarDecleration*> reads;
+    if (shareable && count_ast_nodes(expression) >= 3 && number(expression, key, reads)) {
+        auto found = run->available.find(key);
+        if (found != run->available.end()) {
+            run->values[found->second].uses.push_back(&expression);
+            return;
+        }
+    }
+    else
+        key.clear();
+
+    switch (expression->type) {
+    case AST_INVARIANT:
+    case AST_INDUCTION:
+        // Worked out by the loop the first time it gets there, not each time.
+        break;
+    case AST_ASSIGNMENT:
+        walk(expression);
+        write(AST_CAST(Ast_Assignment, expression)->address.variable);
+        break;
+    case AST_INLINE:
+        walk(expression);
+        run->available.clear();
+        break;
+    default:
+        walk(expression);
+        if (expression->type == AST_PRIMARY && AST_CAST(Ast_PrimaryExpression, expression)->type_value == AST_FUNC_CALL)
+            run->available.clear();
+        break;
+    }
+
+    if (!key.empty()) {
+        run->available[key] = run->values.size();
+        run->values.push_back({ { &expression }, std::move(reads) });
+    }
+}
+
+// Nothing reading the variable is available after it is written, a variable not found could be any.
+void Numberer::write(Ast_VarDecleration* variable) {
+    for (auto it = run->available.begin(); it != run->available.end();) {
+        if (!variable || run->values[it->second].reads.count(variable))
+            it = run->available.erase(it);
+        else
+            it++;
+    }
+}
+
+// Puts the values used more than once in slots.
+void Numberer::end() {
+    for (auto& value : run->values) {
+        if (value.uses.size() < 2)
+            continue;
+
+        uint32_t slot = (*frame_size)++;
+        for (size_t i = 0; i < value.uses.size(); i++) {
+            Ast_Expression*& use = *value.uses[i];
+            auto common = unit->arena.make<Ast_CommonExpression>((i == 0) ? use : nullptr, slot);
+            common->line = use->line;
+            common->origin = use->origin;
+            common->value_type = use->value_type;
+            use = common;
+            if (i > 0)
+                stats.note("shared a common subexpression", *common);
+        }
+        stats.shared += (uint32_t) value.uses.size() - 1;
+    }
+    run->values.clear();
+    run->available.clear();
+}
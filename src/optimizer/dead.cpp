@@ -0,0 +1,306 @@
+/**
+ * @file dead.cpp
+ * @author strah19
+ * @date July 25 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Takes out the parts of a program that can never run.
+ */
+
+#include "optimizer.h"
+
+#include <unordered_set>
+#include <vector>
+
+// A branch runs when its condition is the boolean true, anything else skips it, so a literal
+// condition decides the branch before the program runs. A branch that never runs is dropped from
+// its chain, and one that always runs takes the place of the branches after it as the else.
+//
+// Only a return at the top of a function body ends the function, and there is no way out of a
+// while loop but an error, so what comes after either in the same scope never runs. Function
+// declarations are kept there, the function can still be called from the code before.
+//
+// A function that nothing left in the program calls is taken out last. Running a declaration
+// does nothing, calls go straight to the function they were bound to, so taking one out can not
+// change what the program does.
+class Eliminator {
+public:
+    Eliminator(OptimizeStats& stats) : stats(stats) { }
+
+    void prune(Ast_List<Ast_Decleration*>& declerations, bool function_body);
+    void mark(const Ast_List<Ast_Decleration*>& declerations);
+    void sweep(Ast_List<Ast_Decleration*>& declerations);
+private:
+    Ast_Decleration* statement(Ast_Decleration* decleration);
+    Ast_Decleration* chain(Ast_ConditionalStatement* head);
+    void mark(Ast_Decleration* decleration);
+    void mark(Ast_Expression* expression);
+
+    OptimizeStats& stats;
+
+    std::unordered_set<Ast_FuncDecleration*> called;
+    std::vector<Ast_FuncDecleration*> bodies; // called functions whose bodies are still to be marked
+    bool skipped = false; // a called function's body was skipped by the parser, what it calls is not known
+};
+
+static bool is_true(Ast_Expression* expression) {
+    auto literal = AST_CAST(Ast_PrimaryExpression, expression);
+    return literal->type_value == AST_BOOLEAN && literal->boolean;
+}
+
+// A branch of a chain without the branches after it.
+static uint32_t branch_nodes(Ast_ConditionalStatement* branch) {
+    return 1 + count_ast_nodes(branch->condition) + count_ast_nodes(branch->scope);
+}
+
+void eliminate_dead_code(Ast_TranslationUnit* unit, OptimizeStats& stats) {
+    Eliminator eliminator(stats);
+    eliminator.prune(unit->declerations, false);
+    eliminator.mark(unit->declerations);
+    eliminator.sweep(unit->declerations);
+}
+
+void Eliminator::prune(Ast_List<Ast_Decleration*>& declerations, bool function_body) {
+    uint32_t kept = 0;
+    bool reachable = true;
+    for (auto decleration : declerations) {
+        if (decleration && !reachable && decleration->type != AST_FUNC_DECLERATION) {
+            stats.eliminated += count_ast_nodes(decleration);
+            continue;
+        }
+
+        decleration = statement(decleration);
+        if (!decleration)
+            continue;
+        declerations[kept++] = decleration;
+
+        if (function_body && decleration->type == AST_RETURN)
+            reachable = false;
+        else if (decleration->type == AST_WHILE && is_ast_literal(AST_CAST(Ast_WhileLoop, decleration)->condition))
+            reachable = false;
+    }
+    declerations.count = kept;
+}
+
+/**
+ * Prunes a statement and what is under it.
+ *
+ * @return Ast_Decleration* What takes the place of the statement, nullptr when it can be dropped.
+ */
+Ast_Decleration* Eliminator::statement(Ast_Decleration* decleration) {
+    if (!decleration)
+        return nullptr;
+
+    switch (decleration->type) {
+    case AST_SCOPE: {
+        auto scope = AST_CAST(Ast_Scope, decleration);
+        prune(scope->declerations, false);
+        // The slots of an empty scope were never set, clearing them does nothing.
+        if (scope->declerations.size() == 0) {
+            stats.eliminated++;
+            return nullptr;
+        }
+        return scope;
+    }
+    case AST_FUNC_DECLERATION: {
+        auto func = AST_CAST(Ast_FuncDecleration, decleration);
+        if (func->scope)
+            prune(func->scope->declerations, true);
+        return func;
+    }
+    case AST_IF:
+        return chain(AST_CAST(Ast_ConditionalStatement, decleration));
+    case AST_WHILE: {
+        auto loop = AST_CAST(Ast_WhileLoop, decleration);
+        if (is_ast_literal(loop->condition) && !is_true(loop->condition)) {
+            stats.eliminated += count_ast_nodes(loop);
+            return nullptr;
+        }
+        if (loop->scope)
+            prune(loop->scope->declerations, false);
+        return loop;
+    }
+    }
+    return decleration;
+}
+
+/**
+ * Drops the branches of an if chain that never run and cuts it off at the first one that always
+ * does. A chain that is left with one branch that always runs is just its scope.
+ */
+Ast_Decleration* Eliminator::chain(Ast_ConditionalStatement* head) {
+    std::vector<Ast_ConditionalStatement*> branches;
+    bool always = false;
+    for (auto branch = head; branch; branch = branch->next) {
+        if (always) {
+            stats.eliminated += branch_nodes(branch);
+            continue;
+        }
+        if (branch->type != AST_ELSE && is_ast_literal(branch->condition)) {
+            if (!is_true(branch->condition)) {
+                stats.eliminated += branch_nodes(branch);
+                continue;
+            }
+            stats.eliminated += count_ast_nodes(branch->condition);
+            branch->type = AST_ELSE;
+            branch->condition = nullptr;
+        }
+
+        if (branch->scope)
+            prune(branch->scope->declerations, false);
+        branches.push_back(branch);
+        always = branch->type == AST_ELSE;
+    }
+
+    if (branches.empty())
+        return nullptr;
+    if (branches[0]->type == AST_ELSE) {
+        stats.eliminated++;
+        return branches[0]->scope;
+    }
+
+    branches[0]->type = AST_IF;
+    for (size_t i = 0; i + 1 < branches.size(); i++)
+        branches[i]->next = branches[i + 1];
+    branches.back()->next = nullptr;
+    return branches[0];
+}
+
+// Finds every function that can be called, starting from the code that is not in a function.
+void Eliminator::mark(const Ast_List<Ast_Decleration*>& declerations) {
+    for (auto decleration : declerations)
+        mark(decleration);
+
+    while (!bodies.empty()) {
+        Ast_FuncDecleration* func = bodies.back();
+        bodies.pop_back();
+        for (auto decleration : func->scope->declerations)
+            mark(decleration);
+    }
+}
+
+void Eliminator::mark(Ast_Decleration* decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        mark(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+        break;
+    case AST_PRINT:
+        for (auto printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            mark(printed);
+        break;
+    case AST_SCOPE:
+        for (auto inner : AST_CAST(Ast_Scope, decleration)->declerations)
+            mark(inner);
+        break;
+    case AST_VAR_DECLERATION:
+        mark(AST_CAST(Ast_VarDecleration, decleration)->expression);
+        break;
+    case AST_RETURN:
+        mark(AST_CAST(Ast_ReturnStatement, decleration)->expression);
+        break;
+    case AST_IF:
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE:
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            mark(conditional->condition);
+            mark(conditional->scope);
+        }
+        break;
+    }
+}
+
+void Eliminator::mark(Ast_Expression* expression) {
+    if (!expression)
+        return;
+
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_NESTED)
+            mark(primary->nested);
+        else if (primary->type_value == AST_CAST)
+            mark(primary->cast.expression);
+        else if (primary->type_value == AST_FUNC_CALL) {
+            Ast_FuncDecleration* func = primary->call->function;
+            if (func && !func->scope)
+                skipped = true;
+            else if (func && called.insert(func).second)
+                bodies.push_back(func);
+            for (auto arg : primary->call->args)
+                mark(arg);
+        }
+        break;
+    }
+    case AST_UNARY:
+        mark(AST_CAST(Ast_UnaryExpression, expression)->next);
+        break;
+    case AST_BINARY:
+        mark(AST_CAST(Ast_BinaryExpression, expression)->left);
+        mark(AST_CAST(Ast_BinaryExpression, expression)->right);
+        break;
+    case AST_ASSIGNMENT:
+        mark(AST_CAST(Ast_Assignment, expression)->expression);
+        break;
+    case AST_INLINE: {
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        for (auto arg : inlined->args)
+            mark(arg);
+        mark(inlined->body);
+        break;
+    }
+    case AST_INVARIANT:
+        mark(AST_CAST(Ast_LoopInvariant, expression)->expression);
+        break;
+    case AST_COMMON:
+        mark(AST_CAST(Ast_CommonExpression, expression)->expression);
+        break;
+    case AST_INDUCTION:
+        mark(AST_CAST(Ast_Induction, expression)->left);
+        mark(AST_CAST(Ast_Induction, expression)->right);
+        break;
+    }
+}
+
+// Takes out the functions that were not marked, unless a body that was called has not been parsed
+// yet. It could call any of them.
+void Eliminator::sweep(Ast_List<Ast_Decleration*>& declerations) {
+    if (skipped)
+        return;
+
+    uint32_t kept = 0;
+    for (auto decleration : declerations) {
+        if (decleration && decleration->type == AST_FUNC_DECLERATION) {
+            auto func = AST_CAST(Ast_FuncDecleration, decleration);
+            if (!func->scope) {
+                declerations[kept++] = func;
+                continue;
+            }
+            if (called.count(func) == 0) {
+                stats.eliminated += count_ast_nodes(func);
+                continue;
+            }
+            sweep(func->scope->declerations);
+        }
+        else if (decleration && decleration->type == AST_SCOPE)
+            sweep(AST_CAST(Ast_Scope, decleration)->declerations);
+        else if (decleration && (decleration->type == AST_IF || decleration->type == AST_WHILE)) {
+            for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next)
+                if (conditional->scope)
+                    sweep(conditional->scope->declerations);
+        }
+        declerations[kept++] = decleration;
+    }
+    declerations.count = kept;
+}
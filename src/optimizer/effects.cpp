@@ -0,0 +1,185 @@
+/**
+ * @file effects.cpp
+ * @author strah19
+ * @date July 28 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Finds what the code of a loop can change.
+ */
+
+#include "effects.h"
+
+Effects EffectAnalysis::loop(Ast_WhileLoop* loop) {
+    Direct found;
+    direct(loop, found);
+
+    Effects effects = found.effects;
+    std::unordered_set<Ast_FuncDecleration*> seen;
+    for (size_t i = 0; i < found.called.size() && !effects.anything; i++) {
+        Ast_FuncDecleration* func = found.called[i];
+        if (!seen.insert(func).second)
+            continue;
+
+        const Direct& called = body(func);
+        effects.anything |= called.effects.anything;
+        effects.written.insert(called.effects.written.begin(), called.effects.written.end());
+        // Incremented only means by the loop's own code, which keeps the inductions in its frame.
+        effects.written.insert(called.effects.incremented.begin(), called.effects.incremented.end());
+        found.called.insert(found.called.end(), called.called.begin(), called.called.end());
+    }
+    return effects;
+}
+
+const EffectAnalysis::Direct& EffectAnalysis::body(Ast_FuncDecleration* func) {
+    auto found = bodies.find(func);
+    if (found != bodies.end())
+        return found->second;
+
+    Direct& direct = bodies[func];
+    if (!func->scope)
+        direct.effects.anything = true;
+    else {
+        for (auto decleration : func->scope->declerations)
+            this->direct(decleration, direct);
+    }
+    return direct;
+}
+
+void EffectAnalysis::direct(Ast_Decleration* decleration, Direct& direct) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        this->direct(AST_CAST(Ast_ExpressionStatement, decleration)->expression, direct);
+        break;
+    case AST_PRINT:
+        for (auto printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            this->direct(printed, direct);
+        break;
+    case AST_SCOPE:
+        for (auto inner : AST_CAST(Ast_Scope, decleration)->declerations)
+            this->direct(inner, direct);
+        break;
+    case AST_VAR_DECLERATION: {
+        auto var = AST_CAST(Ast_VarDecleration, decleration);
+        direct.effects.written.insert(var);
+        this->direct(var->expression, direct);
+        break;
+    }
+    case AST_INCREMENT:
+        direct.effects.incremented.insert(AST_CAST(Ast_Increment, decleration)->address.variable);
+        break;
+    case AST_RETURN:
+        this->direct(AST_CAST(Ast_ReturnStatement, decleration)->expression, direct);
+        break;
+    case AST_IF:
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE:
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            this->direct(conditional->condition, direct);
+            this->direct(conditional->scope, direct);
+        }
+        break;
+    }
+}
+
+void EffectAnalysis::direct(Ast_Expression* expression, Direct& direct) {
+    if (!expression)
+        return;
+
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_NESTED)
+            this->direct(primary->nested, direct);
+        else if (primary->type_value == AST_CAST)
+            this->direct(primary->cast.expression, direct);
+        else if (primary->type_value == AST_FUNC_CALL) {
+            if (primary->call->function)
+                direct.called.push_back(primary->call->function);
+            for (auto arg : primary->call->args)
+                this->direct(arg, direct);
+        }
+        break;
+    }
+    case AST_UNARY:
+        this->direct(AST_CAST(Ast_UnaryExpression, expression)->next, direct);
+        break;
+    case AST_BINARY:
+        this->direct(AST_CAST(Ast_BinaryExpression, expression)->left, direct);
+        this->direct(AST_CAST(Ast_BinaryExpression, expression)->right, direct);
+        break;
+    case AST_ASSIGNMENT: {
+        auto assign = AST_CAST(Ast_Assignment, expression);
+        direct.effects.written.insert(assign->address.variable);
+        this->direct(assign->expression, direct);
+        break;
+    }
+    case AST_INLINE: {
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        for (auto arg : inlined->args)
+            this->direct(arg, direct);
+        this->direct(inlined->body, direct);
+        break;
+    }
+    case AST_INVARIANT:
+        this->direct(AST_CAST(Ast_LoopInvariant, expression)->expression, direct);
+        break;
+    case AST_COMMON:
+        this->direct(AST_CAST(Ast_CommonExpression, expression)->expression, direct);
+        break;
+    case AST_INDUCTION:
+        this->direct(AST_CAST(Ast_Induction, expression)->left, direct);
+        this->direct(AST_CAST(Ast_Induction, expression)->right, direct);
+        break;
+    }
+}
+
+bool is_invariant(Ast_Expression* expression, const Effects& loop) {
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        switch (primary->type_value) {
+        case AST_INT:
+        case AST_FLOAT:
+        case AST_CHAR:
+        case AST_BOOLEAN:
+        case AST_STRING:
+            return true;
+        case AST_ID:
+            return primary->address.variable && !loop.writes(primary->address.variable);
+        case AST_NESTED:
+            return is_invariant(primary->nested, loop);
+        case AST_CAST:
+            return is_invariant(primary->cast.expression, loop);
+        }
+        return false;
+    }
+    case AST_UNARY:
+        return is_invariant(AST_CAST(Ast_UnaryExpression, expression)->next, loop);
+    case AST_BINARY:
+        return is_invariant(AST_CAST(Ast_BinaryExpression, expression)->left, loop) &&
+               is_invariant(AST_CAST(Ast_BinaryExpression, expression)->right, loop);
+    case AST_INLINE: {
+        // The parameters are only written by the call itself, they do not change if the arguments do not.
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        for (auto arg : inlined->args)
+            if (!is_invariant(arg, loop))
+                return false;
+        return is_invariant(inlined->body, loop);
+    }
+    case AST_INVARIANT:
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file fold.cpp
+ * @author strah19
+ * @date July 24 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Works out the constant parts of expressions before the program runs.
+ */
+
+#include "optimizer.h"
+#include "interpreter.h"
+
+#include <climits>
+#include <unordered_map>
+#include <vector>
+
+// The operators are worked out with the same operations the interpreter runs them with, so a
+// folded expression gives the value it would have given. One that would fail, like a division
+// by zero, is left for the interpreter to fail on.
+//
+// A constant variable whose value folds to a literal is replaced by that literal where it is used.
+// A use in the frame the constant is declared in always comes after the declaration, the resolver
+// sees to that. A use in a function body can run before it though, if the function is called from
+// somewhere before the declaration, and using the constant there is an error. So those uses are
+// only replaced when nothing before the declaration in its scope calls a function, which is the
+// only way to get into a function that can see the constant.
+class Folder {
+public:
+    Folder(Ast_TranslationUnit* unit, OptimizeStats& stats) : unit(unit), stats(stats) { }
+
+    void scope(const Ast_List<Ast_Decleration*>& declerations);
+private:
+    struct Constant {
+        Object value;
+        int type;
+        bool in_functions; // can be put in place of uses in function bodies
+    };
+
+    void decleration(Ast_Decleration* decleration);
+    void expression(Ast_Expression*& expression);
+    void primary(Ast_Expression*& expression);
+    void replace(Ast_Expression*& expression, const Object& value, int type);
+
+    Ast_TranslationUnit* unit;
+    OptimizeStats& stats;
+
+    std::unordered_map<Ast_VarDecleration*, Constant> constants;
+
+    // Calls met so far, and how many there were when the scope being folded began.
+    uint32_t calls = 0;
+    uint32_t scope_calls = 0;
+};
+
+// A literal the folder works with. String literals are left alone, working out an operator on
+// strings makes a new string that the tree has nowhere to keep.
+static bool is_value_literal(Ast_Expression* expression) {
+    return is_ast_literal(expression) && AST_CAST(Ast_PrimaryExpression, expression)->type_value != AST_STRING;
+}
+
+static Object literal_value(Ast_Expression* expression) {
+    auto literal = AST_CAST(Ast_PrimaryExpression, expression);
+    switch (literal->type_value) {
+    case AST_INT:   return Object::init_int(literal->int_const);
+    case AST_FLOAT: return Object::init_float(literal->float_const);
+    case AST_CHAR:  return Object::init_char(literal->char_const);
+    default:        return Object::init_bool(literal->boolean);
+    }
+}
+
+// The smallest int divided by -1 does not fit, working it out here would stop the optimizer.
+static bool overflows(int op, int type, const Object& left, const Object& right) {
+    return type == AST_INT && (op == AST_OPERATOR_DIVISION || op == AST_OPERATOR_MODULO) &&
+           left.int_const == INT_MIN && right.int_const == -1;
+}
+
+void fold_constants(Ast_TranslationUnit* unit, OptimizeStats& stats) {
+    Folder folder(unit, stats);
+    folder.scope(unit->declerations);
+}
+
+// The function bodies of a scope are folded once the scope is done, the way the resolver does
+// them, so every constant they can see is known by then.
+void Folder::scope(const Ast_List<Ast_Decleration*>& declerations) {
+    uint32_t outer_calls = scope_calls;
+    scope_calls = calls;
+
+    std::vector<Ast_FuncDecleration*> bodies;
+    for (auto decleration : declerations) {
+        if (decleration && decleration->type == AST_FUNC_DECLERATION)
+            bodies.push_back(AST_CAST(Ast_FuncDecleration, decleration));
+        else
+            this->decleration(decleration);
+    }
+
+    // The calls in the bodies are not made by the scope.
+    uint32_t made = calls;
+    for (auto func : bodies)
+        if (func->scope)
+            scope(func->scope->declerations);
+    calls = made;
+    scope_calls = outer_calls;
+}
+
+void Folder::decleration(Ast_Decleration* decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        expression(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+        break;
+    case AST_PRINT:
+        for (auto& printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            expression(printed);
+        break;
+    case AST_SCOPE:
+        scope(AST_CAST(Ast_Scope, decleration)->declerations);
+        break;
+    case AST_VAR_DECLERATION: {
+        auto var = AST_CAST(Ast_VarDecleration, decleration);
+        expression(var->expression);
+        if ((var->specifiers & AST_SPECIFIER_CONST) && var->expression && is_value_literal(var->expression) &&
+            var->expression->value_type == var->type_value)
+            constants[var] = { literal_value(var->expression), var->type_value, calls == scope_calls };
+        break;
+    }
+    case AST_RETURN:
+        expression(AST_CAST(Ast_ReturnStatement, decleration)->expression);
+        break;
+    case AST_IF:
+    case AST_ELIF:
+    case AST_ELSE:
+    case AST_WHILE:
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            expression(conditional->condition);
+            if (conditional->scope)
+                scope(conditional->scope->declerations);
+        }
+        break;
+    }
+}
+
+void Folder::expression(Ast_Expression*& expression) {
+    if (!expression)
+        return;
+
+    switch (expression->type) {
+    case AST_PRIMARY:
+        primary(expression);
+        break;
+    case AST_UNARY: {
+        auto unary = AST_CAST(Ast_UnaryExpression, expression);
+        this->expression(unary->next);
+        if (unary->value_type == AST_TYPE_NONE || !is_value_literal(unary->next))
+            break;
+
+        replace(expression, Interpreter::apply_typed_unary(unary->op, unary->next->value_type, literal_value(unary->next)), unary->value_type);
+        stats.folded++;
+        break;
+    }
+    case AST_BINARY: {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        this->expression(binary->left);
+        this->expression(binary->right);
+        if (binary->value_type == AST_TYPE_NONE || !is_value_literal(binary->left) || !is_value_literal(binary->right))
+            break;
+
+        Object left = literal_value(binary->left);
+        Object right = literal_value(binary->right);
+        if (overflows(binary->op, binary->left->value_type, left, right))
+            break;
+        Object value = Interpreter::apply_typed_binary(binary->op, binary->left->value_type, left, right);
+        if (value.found_errors())
+            break;
+
+        replace(expression, value, binary->value_type);
+        stats.folded++;
+        break;
+    }
+    case AST_ASSIGNMENT:
+        this->expression(AST_CAST(Ast_Assignment, expression)->expression);
+        break;
+    }
+}
+
+void Folder::primary(Ast_Expression*& expression) {
+    auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+    switch (primary->type_value) {
+    case AST_NESTED:
+        // Brackets only group, the nested expression takes the place of the node. An assignment
+        // keeps them, one right of another is taken as a chain of assignments.
+        this->expression(primary->nested);
+        if (primary->nested->type != AST_ASSIGNMENT)
+            expression = primary->nested;
+        break;
+    case AST_CAST: {
+        this->expression(primary->cast.expression);
+        if (primary->value_type == AST_TYPE_NONE || !is_value_literal(primary->cast.expression))
+            break;
+
+        Object value = literal_value(primary->cast.expression);
+        Object casting_obj;
+        casting_obj.type = Interpreter::convert_to_interpreter_type(primary->cast.cast_type);
+        if (value.convert(casting_obj) != OBJ_ERROR_NONE)
+            break;
+
+        replace(expression, value, primary->value_type);
+        stats.folded++;
+        break;
+    }
+    case AST_ID: {
+        auto found = constants.find(primary->address.variable);
+        if (found == constants.end() || (primary->address.depth > 0 && !found->second.in_functions))
+            break;
+        replace(expression, found->second.value, found->second.type);
+        stats.propagated++;
+        break;
+    }
+    case AST_FUNC_CALL:
+        calls++;
+        for (auto& arg : primary->call->args)
+            this->expression(arg);
+        break;
+    }
+}
+
+// Puts a literal with the value in place of the expression.
+void Folder::replace(Ast_Expression*& expression, const Object& value, int type) {
+    auto literal = unit->arena.make<Ast_PrimaryExpression>();
+    literal->type_value = type;
+    literal->value_type = type;
+    literal->line = expression->line;
+    literal->origin = expression->origin;
+    switch (type) {
+    case AST_INT:   literal->int_const = value.int_const; break;
+    case AST_FLOAT: literal->float_const = value.float_const; break;
+    case AST_CHAR:  literal->char_const = value.char_const; break;
+    default:        literal->boolean = value.boolean; break;
+    }
+
+    expression = literal;
+}
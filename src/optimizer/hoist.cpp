@@ -0,0 +1,95 @@
+/**
+ * @file hoist.cpp
+ * @author strah19
+ * @date July 27 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Works out the parts of a while loop that do not change while it runs only once.
+ */
+
+#include "optimizer.h"
+#include "effects.h"
+#include "walker.h"
+
+// The largest invariant expressions of a loop that do some work are put in an Ast_LoopInvariant,
+// see effects.h for what is invariant. It is only worked out where the expression was, the first
+// time the loop gets there, so an expression that fails still fails at the same place, and one
+// that the loop never gets to is never worked out.
+//
+// A loop is hoisted from as a whole, the loops inside it included, before the loops inside it are
+// hoisted from on their own.
+class Hoister : public Walker {
+public:
+    Hoister(Ast_TranslationUnit* unit, OptimizeStats& stats) : Walker(unit), stats(stats) { }
+private:
+    void decleration(Ast_Decleration*& decleration) override;
+    void expression(Ast_Expression*& expression) override;
+    void function(Ast_FuncDecleration* func) override;
+    void loop(Ast_WhileLoop* loop);
+
+    OptimizeStats& stats;
+
+    EffectAnalysis analysis;
+    const Effects* current = nullptr; // of the loop being hoisted from
+};
+
+void hoist_loop_invariants(Ast_TranslationUnit* unit, OptimizeStats& stats) {
+    Hoister hoister(unit, stats);
+    hoister.program(unit->declerations);
+}
+
+void Hoister::decleration(Ast_Decleration*& decleration) {
+    if (decleration && decleration->type == AST_WHILE && !current)
+        loop(AST_CAST(Ast_WhileLoop, decleration));
+    else
+        walk(decleration);
+}
+
+// The code of a function declared in a loop does not run in it.
+void Hoister::function(Ast_FuncDecleration* func) {
+    if (!current)
+        Walker::function(func);
+}
+
+void Hoister::loop(Ast_WhileLoop* loop) {
+    Effects effects = analysis.loop(loop);
+
+    current = &effects;
+    loop->first_invariant = *frame_size;
+    Ast_Decleration* whole = loop;
+    walk(whole);
+    loop->invariant_count = *frame_size - loop->first_invariant;
+    current = nullptr;
+
+    if (loop->scope)
+        block(loop->scope->declerations);
+}
+
+// The parts of an expression already hoisted from a loop around this one are left as they are.
+void Hoister::expression(Ast_Expression*& expression) {
+    if (!current || !expression || expression->type == AST_INVARIANT)
+        return;
+
+    bool leaf = expression->type == AST_PRIMARY &&
+        AST_CAST(Ast_PrimaryExpression, expression)->type_value != AST_NESTED &&
+        AST_CAST(Ast_PrimaryExpression, expression)->type_value != AST_CAST;
+    if (!leaf && is_invariant(expression, *current)) {
+        auto hoisted = unit->arena.make<Ast_LoopInvariant>(expression, (*frame_size)++);
+        hoisted->line = expression->line;
+        hoisted->origin = expression->origin;
+        hoisted->value_type = expression->value_type;
+        expression = hoisted;
+        stats.hoisted++;
+        stats.note("hoisted a loop invariant", *hoisted);
+        return;
+    }
+    walk(expression);
+}
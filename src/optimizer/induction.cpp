@@ -0,0 +1,221 @@
+/**
+ * @file induction.cpp
+ * @author strah19
+ * @date July 28 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Turns counters into increments and the products of them in loops into running sums.
+ */
+
+#include "optimizer.h"
+#include "effects.h"
+#include "walker.h"
+
+#include <climits>
+#include <vector>
+
+// A statement x = x + c;, x = c + x;, x = x - c;, x += c; or x -= c; the checker gave an int or
+// float type, with c a literal of that type, becomes an Ast_Increment.
+//
+// A variable a while loop only changes by the increments in its own code is an induction variable
+// of the loop. An int product of one and an expression that is invariant in the loop, see
+// effects.h, becomes an Ast_Induction, worked out once and then moved along by the increments of
+// the variable. Float products are left alone, adding up the steps would not round the same way.
+//
+// A loop's own loops are done first, a product they reduced is kept out of the ones around them.
+class Reducer : public Walker {
+public:
+    Reducer(Ast_TranslationUnit* unit, OptimizeStats& stats) : Walker(unit), stats(stats) { }
+private:
+    void decleration(Ast_Decleration*& decleration) override;
+    void expression(Ast_Expression*& expression) override;
+    void function(Ast_FuncDecleration* func) override;
+    Ast_Decleration* increment(Ast_ExpressionStatement* statement);
+    void loop(Ast_WhileLoop* loop);
+
+    OptimizeStats& stats;
+
+    EffectAnalysis analysis;
+    const Effects* current = nullptr; // of the loop whose products are being reduced
+
+    // The increments of the loop and the slots of its inductions with their variables.
+    std::vector<Ast_Increment*> increments;
+    std::vector<std::pair<Ast_VarDecleration*, uint32_t>> inductions;
+};
+
+void reduce_induction_variables(Ast_TranslationUnit* unit, OptimizeStats& stats) {
+    Reducer reducer(unit, stats);
+    reducer.program(unit->declerations);
+}
+
+void Reducer::decleration(Ast_Decleration*& decleration) {
+    if (!decleration)
+        return;
+
+    if (current) {
+        if (decleration->type == AST_INCREMENT)
+            increments.push_back(AST_CAST(Ast_Increment, decleration));
+        walk(decleration);
+    }
+    else if (decleration->type == AST_EXPRESSION_STATEMENT) {
+        if (auto increment = this->increment(AST_CAST(Ast_ExpressionStatement, decleration))) {
+            decleration = increment;
+            stats.incremented++;
+            stats.note("made an increment", *increment);
+        }
+    }
+    else if (decleration->type == AST_WHILE)
+        loop(AST_CAST(Ast_WhileLoop, decleration));
+    else
+        walk(decleration);
+}
+
+// The code of a function declared in a loop does not run in it.
+void Reducer::function(Ast_FuncDecleration* func) {
+    if (!current)
+        Walker::function(func);
+}
+
+static bool same_address(const Ast_Address& a, const Ast_Address& b) {
+    return a.depth == b.depth && a.slot == b.slot;
+}
+
+// The literal of the type added to the variable by the assignment, or null.
+static Ast_PrimaryExpression* step(Ast_Assignment* assign, bool& negate) {
+    auto literal = [assign](Ast_Expression* expression) -> Ast_PrimaryExpression* {
+        if (expression->type != AST_PRIMARY || AST_CAST(Ast_PrimaryExpression, expression)->type_value != assign->value_type)
+            return nullptr;
+        return AST_CAST(Ast_PrimaryExpression, expression);
+    };
+    auto variable = [assign](Ast_Expression* expression) {
+        return expression->type == AST_PRIMARY && AST_CAST(Ast_PrimaryExpression, expression)->type_value == AST_ID &&
+               same_address(AST_CAST(Ast_PrimaryExpression, expression)->address, assign->address);
+    };
+
+    negate = (assign->equal_type == AST_EQUAL_MINUS);
+    if (assign->equal_type == AST_EQUAL_PLUS || assign->equal_type == AST_EQUAL_MINUS)
+        return literal(assign->expression);
+    if (assign->equal_type != AST_EQUAL || assign->expression->type != AST_BINARY)
+        return nullptr;
+
+    auto binary = AST_CAST(Ast_BinaryExpression, assign->expression);
+    if (binary->value_type != assign->value_type)
+        return nullptr;
+    negate = (binary->op == AST_OPERATOR_SUB);
+    if (binary->op == AST_OPERATOR_ADD && variable(binary->right))
+        return literal(binary->left);
+    if (binary->op == AST_OPERATOR_ADD || binary->op == AST_OPERATOR_SUB)
+        return variable(binary->left) ? literal(binary->right) : nullptr;
+    return nullptr;
+}
+
+Ast_Decleration* Reducer::increment(Ast_ExpressionStatement* statement) {
+    if (statement->expression->type != AST_ASSIGNMENT)
+        return nullptr;
+
+    auto assign = AST_CAST(Ast_Assignment, statement->expression);
+    if ((assign->value_type != AST_INT && assign->value_type != AST_FLOAT) || !assign->address.variable)
+        return nullptr;
+
+    bool negate = false;
+    Ast_PrimaryExpression* literal = step(assign, negate);
+    if (!literal || (negate && assign->value_type == AST_INT && literal->int_const == INT_MIN))
+        return nullptr;
+
+    auto increment = unit->arena.make<Ast_Increment>();
+    increment->line = assign->line;
+    increment->origin = assign->origin;
+    increment->address = assign->address;
+    increment->value_type = assign->value_type;
+    if (assign->value_type == AST_INT)
+        increment->int_const = negate ? -literal->int_const : literal->int_const;
+    else
+        increment->float_const = negate ? -literal->float_const : literal->float_const;
+    return increment;
+}
+
+void Reducer::loop(Ast_WhileLoop* loop) {
+    if (loop->scope)
+        block(loop->scope->declerations);
+
+    Effects effects = analysis.loop(loop);
+    if (effects.anything || effects.incremented.empty())
+        return;
+
+    current = &effects;
+    loop->first_induction = *frame_size;
+    Ast_Decleration* whole = loop;
+    walk(whole);
+    loop->induction_count = *frame_size - loop->first_induction;
+    current = nullptr;
+
+    for (auto& [variable, slot] : inductions) {
+        for (auto increment : increments) {
+            if (increment->address.variable == variable)
+                increment->inductions.push_back(unit->arena, slot);
+        }
+    }
+    increments.clear();
+    inductions.clear();
+}
+
+static Ast_VarDecleration* induction_variable(Ast_Expression* expression, const Effects& loop) {
+    if (expression->type != AST_PRIMARY || AST_CAST(Ast_PrimaryExpression, expression)->type_value != AST_ID)
+        return nullptr;
+
+    Ast_VarDecleration* variable = AST_CAST(Ast_PrimaryExpression, expression)->address.variable;
+    if (!variable || !loop.incremented.count(variable) || loop.written.count(variable))
+        return nullptr;
+    return variable;
+}
+
+// The bodies of inlined calls are left as they are, their parameters are not the loop's variables.
+// A product reduced in a loop inside this one is left as it is too.
+void Reducer::expression(Ast_Expression*& expression) {
+    if (!current || !expression || expression->type == AST_INDUCTION)
+        return;
+
+    if (expression->type == AST_BINARY) {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        if (binary->op == AST_OPERATOR_MULTIPLICATIVE && binary->value_type == AST_INT &&
+            binary->left->value_type == AST_INT && binary->right->value_type == AST_INT) {
+            bool variable_left = true;
+            Ast_VarDecleration* variable = induction_variable(binary->left, *current);
+            if (!variable || !is_invariant(binary->right, *current)) {
+                variable_left = false;
+                variable = induction_variable(binary->right, *current);
+                if (variable && !is_invariant(binary->left, *current))
+                    variable = nullptr;
+            }
+
+            if (variable) {
+                auto induction = unit->arena.make<Ast_Induction>();
+                induction->line = binary->line;
+                induction->origin = binary->origin;
+                induction->value_type = binary->value_type;
+                induction->left = binary->left;
+                induction->right = binary->right;
+                induction->variable_left = variable_left;
+                induction->slot = *frame_size;
+                *frame_size += 2;
+                inductions.push_back({ variable, induction->slot });
+                expression = induction;
+                stats.reduced++;
+                stats.note("reduced an induction product", *induction);
+                return;
+            }
+        }
+    }
+
+    // An invariant of a loop inside this one is worked out again each time that loop starts, so
+    // the walk goes on into it.
+    walk(expression);
+}
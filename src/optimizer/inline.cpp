@@ -0,0 +1,303 @@
+/**
+ * @file inline.cpp
+ * @author strah19
+ * @date July 26 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Puts the bodies of small functions in place of the calls to them.
+ */
+
+#include "optimizer.h"
+#include "walker.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A function can be inlined when its body is only a return of a value of its type, no bigger than
+// the size given, and it can not end up calling itself. A call to it that the checker found the
+// right types for becomes an Ast_InlineCall holding a copy of the returned expression.
+//
+// The parameters of the copy live in new slots at the end of the caller's frame, each call site
+// gets its own so one inlined call in the arguments of another can not overwrite them. A literal
+// argument is put in place of its parameter instead, unless the body assigns to it. The other
+// addresses in the copy are made to count the frames from the caller's instead of the function's,
+// which is one frame further down and call->depth frames below the frame the function was
+// declared in.
+class Inliner : public Walker {
+public:
+    Inliner(Ast_TranslationUnit* unit, uint32_t size, OptimizeStats& stats) : Walker(unit), size(size), stats(stats) { }
+
+    void inline_calls();
+private:
+    // Where the copy of a body is being made.
+    struct Site {
+        uint32_t depth; // of the call
+        std::unordered_map<uint32_t, uint32_t> slots; // slots of the function's frame to those of the caller's
+        std::unordered_map<uint32_t, Ast_PrimaryExpression*> literals; // put in place of the parameters in those slots
+    };
+
+    bool inlinable(Ast_FuncDecleration* func);
+    bool reaches(Ast_FuncDecleration* from, Ast_FuncDecleration* to, std::unordered_set<Ast_FuncDecleration*>& seen);
+
+    void expression(Ast_Expression*& expression) override;
+    Ast_Expression* inline_call(Ast_PrimaryExpression* primary);
+    Ast_Expression* clone(Ast_Expression* expression, Site& site);
+    Ast_Address address(Ast_Address address, Site& site);
+
+    uint32_t size;
+    OptimizeStats& stats;
+
+    std::unordered_map<Ast_FuncDecleration*, std::vector<Ast_FuncDecleration*>> callees; // see CallGraph
+    std::unordered_map<Ast_FuncDecleration*, bool> decided;
+};
+
+// Finds the functions called in the code of each function, null for one whose body the parser
+// skipped. Calls outside of functions are not needed.
+class CallGraph : public Walker {
+public:
+    CallGraph(Ast_TranslationUnit* unit, std::unordered_map<Ast_FuncDecleration*, std::vector<Ast_FuncDecleration*>>& callees) :
+        Walker(unit), callees(callees) { }
+private:
+    void function(Ast_FuncDecleration* func) override;
+    void expression(Ast_Expression*& expression) override;
+
+    std::unordered_map<Ast_FuncDecleration*, std::vector<Ast_FuncDecleration*>>& callees;
+    Ast_FuncDecleration* in = nullptr;
+};
+
+// The slots of the function's own frame that an expression assigns to.
+static void assigned(Ast_Expression* expression, std::unordered_set<uint32_t>& slots) {
+    if (!expression)
+        return;
+
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_NESTED)
+            assigned(primary->nested, slots);
+        else if (primary->type_value == AST_CAST)
+            assigned(primary->cast.expression, slots);
+        else if (primary->type_value == AST_FUNC_CALL) {
+            for (auto arg : primary->call->args)
+                assigned(arg, slots);
+        }
+        break;
+    }
+    case AST_UNARY:
+        assigned(AST_CAST(Ast_UnaryExpression, expression)->next, slots);
+        break;
+    case AST_BINARY:
+        assigned(AST_CAST(Ast_BinaryExpression, expression)->left, slots);
+        assigned(AST_CAST(Ast_BinaryExpression, expression)->right, slots);
+        break;
+    case AST_ASSIGNMENT: {
+        auto assign = AST_CAST(Ast_Assignment, expression);
+        if (assign->address.depth == 0)
+            slots.insert(assign->address.slot);
+        assigned(assign->expression, slots);
+        break;
+    }
+    case AST_INLINE: {
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        for (auto arg : inlined->args)
+            assigned(arg, slots);
+        assigned(inlined->body, slots);
+        break;
+    }
+    }
+}
+
+void inline_functions(Ast_TranslationUnit* unit, uint32_t size, OptimizeStats& stats) {
+    Inliner inliner(unit, size, stats);
+    inliner.inline_calls();
+}
+
+void Inliner::inline_calls() {
+    CallGraph graph(unit, callees);
+    graph.program(unit->declerations);
+    program(unit->declerations);
+}
+
+void CallGraph::function(Ast_FuncDecleration* func) {
+    auto& called = callees[func];
+    if (!func->scope)
+        called.push_back(nullptr);
+
+    Ast_FuncDecleration* outer = in;
+    in = func;
+    Walker::function(func);
+    in = outer;
+}
+
+void CallGraph::expression(Ast_Expression*& expression) {
+    if (expression && expression->type == AST_PRIMARY && AST_CAST(Ast_PrimaryExpression, expression)->type_value == AST_FUNC_CALL) {
+        auto call = AST_CAST(Ast_PrimaryExpression, expression)->call;
+        if (in && call->function)
+            callees[in].push_back(call->function);
+    }
+    walk(expression);
+}
+
+// Decided the first time a call to the function is met, the body can grow after that.
+bool Inliner::inlinable(Ast_FuncDecleration* func) {
+    auto found = decided.find(func);
+    if (found != decided.end())
+        return found->second;
+
+    bool can = false;
+    if (func->scope && func->return_type != AST_VOID && func->scope->declerations.size() == 1 &&
+        func->scope->declerations[0]->type == AST_RETURN) {
+        auto ret = AST_CAST(Ast_ReturnStatement, func->scope->declerations[0]);
+        std::unordered_set<Ast_FuncDecleration*> seen;
+        can = ret->expression && ret->expression->value_type == func->return_type &&
+              count_ast_nodes(ret->expression) <= size && !reaches(func, func, seen);
+    }
+
+    decided.emplace(func, can);
+    return can;
+}
+
+// A function whose body has not been parsed could call anything.
+bool Inliner::reaches(Ast_FuncDecleration* from, Ast_FuncDecleration* to, std::unordered_set<Ast_FuncDecleration*>& seen) {
+    for (auto callee : callees[from]) {
+        if (!callee || callee == to)
+            return true;
+        if (seen.insert(callee).second && reaches(callee, to, seen))
+            return true;
+    }
+    return false;
+}
+
+// A call is inlined after its arguments are.
+void Inliner::expression(Ast_Expression*& expression) {
+    walk(expression);
+    if (expression && expression->type == AST_PRIMARY && AST_CAST(Ast_PrimaryExpression, expression)->type_value == AST_FUNC_CALL)
+        expression = inline_call(AST_CAST(Ast_PrimaryExpression, expression));
+}
+
+/**
+ * Puts the body of the function called in place of the call, if it can be inlined.
+ *
+ * @return Ast_Expression* What takes the place of the call.
+ */
+Ast_Expression* Inliner::inline_call(Ast_PrimaryExpression* primary) {
+    Ast_FuncDecleration* func = primary->call->function;
+    if (!func || primary->value_type == AST_TYPE_NONE || !inlinable(func))
+        return primary;
+
+    auto body = AST_CAST(Ast_ReturnStatement, func->scope->declerations[0])->expression;
+    std::unordered_set<uint32_t> written;
+    assigned(body, written);
+
+    Site site;
+    site.depth = primary->call->depth;
+    auto inlined = unit->arena.make<Ast_InlineCall>();
+    inlined->line = primary->line;
+    inlined->origin = primary->origin;
+    inlined->value_type = primary->value_type;
+    inlined->first_slot = *frame_size;
+    for (uint32_t i = 0; i < func->args.size(); i++) {
+        Ast_Expression* arg = primary->call->args[i];
+        uint32_t slot = func->args[i]->slot;
+        if (is_ast_literal(arg) && written.count(slot) == 0) {
+            site.literals[slot] = AST_CAST(Ast_PrimaryExpression, arg);
+            continue;
+        }
+        inlined->args.push_back(unit->arena, arg);
+        site.slots[slot] = (*frame_size)++;
+    }
+
+    inlined->body = clone(body, site);
+    stats.inlined++;
+    stats.note("inlined a call", *inlined);
+    return inlined;
+}
+
+template <typename T>
+static T* located(T* copy, Ast_Expression* from) {
+    copy->line = from->line;
+    copy->origin = from->origin;
+    copy->value_type = from->value_type;
+    return copy;
+}
+
+// Copies an expression of the body, see Inliner for what is changed on the way.
+Ast_Expression* Inliner::clone(Ast_Expression* expression, Site& site) {
+    Arena& arena = unit->arena;
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_ID && primary->address.depth == 0) {
+            auto literal = site.literals.find(primary->address.slot);
+            if (literal != site.literals.end())
+                return arena.make<Ast_PrimaryExpression>(*literal->second);
+        }
+
+        auto copy = arena.make<Ast_PrimaryExpression>(*primary);
+        if (primary->type_value == AST_ID)
+            copy->address = address(primary->address, site);
+        else if (primary->type_value == AST_NESTED)
+            copy->nested = clone(primary->nested, site);
+        else if (primary->type_value == AST_CAST)
+            copy->cast.expression = clone(primary->cast.expression, site);
+        else if (primary->type_value == AST_FUNC_CALL) {
+            Ast_List<Ast_Expression*> args;
+            for (auto arg : primary->call->args)
+                args.push_back(arena, clone(arg, site));
+            copy->call = arena.make<Ast_FunctionCall>(primary->call->ident, args);
+            copy->call->function = primary->call->function;
+            copy->call->depth = primary->call->depth + site.depth - 1;
+        }
+        return copy;
+    }
+    case AST_UNARY: {
+        auto unary = AST_CAST(Ast_UnaryExpression, expression);
+        return located(arena.make<Ast_UnaryExpression>(clone(unary->next, site), unary->op), unary);
+    }
+    case AST_BINARY: {
+        auto binary = AST_CAST(Ast_BinaryExpression, expression);
+        return located(arena.make<Ast_BinaryExpression>(clone(binary->left, site), binary->op, clone(binary->right, site)), binary);
+    }
+    case AST_ASSIGNMENT: {
+        auto assign = AST_CAST(Ast_Assignment, expression);
+        auto copy = located(arena.make<Ast_Assignment>(clone(assign->expression, site), assign->id, assign->equal_type), assign);
+        copy->address = address(assign->address, site);
+        return copy;
+    }
+    case AST_INLINE: {
+        // A call that was inlined into the body, its parameters get slots of their own again.
+        auto inlined = AST_CAST(Ast_InlineCall, expression);
+        auto copy = located(arena.make<Ast_InlineCall>(), inlined);
+        for (auto arg : inlined->args)
+            copy->args.push_back(arena, clone(arg, site));
+        copy->first_slot = *frame_size;
+        for (uint32_t i = 0; i < inlined->args.size(); i++)
+            site.slots[inlined->first_slot + i] = (*frame_size)++;
+        copy->body = clone(inlined->body, site);
+        return copy;
+    }
+    }
+    return expression;
+}
+
+Ast_Address Inliner::address(Ast_Address address, Site& site) {
+    if (address.depth > 0) {
+        address.depth += site.depth - 1;
+        return address;
+    }
+
+    auto found = site.slots.emplace(address.slot, *frame_size);
+    if (found.second)
+        (*frame_size)++;
+    address.slot = found.first->second;
+    return address;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file optimizer.cpp
+ * @author strah19
+ * @date July 24 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Runs the optimisation passes over a checked program.
+ */
+
+#include "optimizer.h"
+
+OptimizeStats optimize_translation_unit(Ast_TranslationUnit* unit, const OptimizeOptions& options) {
+    OptimizeStats stats;
+    fold_constants(unit, stats);
+    eliminate_dead_code(unit, stats);
+    // A body can be small enough once what never runs is gone, and the functions only called from
+    // the calls that were inlined are gone after the second time.
+    if (options.inline_size > 0) {
+        inline_functions(unit, options.inline_size, stats);
+        eliminate_dead_code(unit, stats);
+    }
+    hoist_loop_invariants(unit, stats);
+    reduce_induction_variables(unit, stats);
+    eliminate_common_subexpressions(unit, stats);
+    return stats;
+}
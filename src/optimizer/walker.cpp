@@ -0,0 +1,117 @@
+/**
+ * @file walker.cpp
+ * @author strah19
+ * @date July 30 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Goes over the tree for the optimizer passes.
+ */
+
+#include "walker.h"
+
+void Walker::program(Ast_List<Ast_Decleration*>& declerations) {
+    frame_size = &unit->frame_size;
+    block(declerations);
+}
+
+void Walker::block(Ast_List<Ast_Decleration*>& declerations) {
+    for (auto& decleration : declerations)
+        this->decleration(decleration);
+}
+
+void Walker::function(Ast_FuncDecleration* func) {
+    if (!func->scope)
+        return;
+
+    uint32_t* outer = frame_size;
+    frame_size = &func->frame_size;
+    block(func->scope->declerations);
+    frame_size = outer;
+}
+
+void Walker::walk(Ast_Decleration*& decleration) {
+    if (!decleration)
+        return;
+
+    switch (decleration->type) {
+    case AST_EXPRESSION_STATEMENT:
+        expression(AST_CAST(Ast_ExpressionStatement, decleration)->expression);
+        break;
+    case AST_PRINT:
+        for (auto& printed : AST_CAST(Ast_PrintStatement, decleration)->expressions)
+            expression(printed);
+        break;
+    case AST_SCOPE:
+        block(AST_CAST(Ast_Scope, decleration)->declerations);
+        break;
+    case AST_VAR_DECLERATION:
+        expression(AST_CAST(Ast_VarDecleration, decleration)->expression);
+        break;
+    case AST_FUNC_DECLERATION:
+        function(AST_CAST(Ast_FuncDecleration, decleration));
+        break;
+    case AST_RETURN:
+        expression(AST_CAST(Ast_ReturnStatement, decleration)->expression);
+        break;
+    case AST_IF:
+    case AST_WHILE:
+        for (auto conditional = AST_CAST(Ast_ConditionalStatement, decleration); conditional; conditional = conditional->next) {
+            expression(conditional->condition);
+            if (conditional->scope)
+                block(conditional->scope->declerations);
+        }
+        break;
+    }
+}
+
+void Walker::walk(Ast_Expression*& expression) {
+    if (!expression)
+        return;
+
+    switch (expression->type) {
+    case AST_PRIMARY: {
+        auto primary = AST_CAST(Ast_PrimaryExpression, expression);
+        if (primary->type_value == AST_NESTED)
+            this->expression(primary->nested);
+        else if (primary->type_value == AST_CAST)
+            this->expression(primary->cast.expression);
+        else if (primary->type_value == AST_FUNC_CALL) {
+            for (auto& arg : primary->call->args)
+                this->expression(arg);
+        }
+        break;
+    }
+    case AST_UNARY:
+        this->expression(AST_CAST(Ast_UnaryExpression, expression)->next);
+        break;
+    case AST_BINARY:
+        this->expression(AST_CAST(Ast_BinaryExpression, expression)->left);
+        this->expression(AST_CAST(Ast_BinaryExpression, expression)->right);
+        break;
+    case AST_ASSIGNMENT:
+        this->expression(AST_CAST(Ast_Assignment, expression)->expression);
+        break;
+    case AST_INLINE:
+        for (auto& arg : AST_CAST(Ast_InlineCall, expression)->args)
+            this->expression(arg);
+        break;
+    case AST_INVARIANT:
+        this->expression(AST_CAST(Ast_LoopInvariant, expression)->expression);
+        break;
+    case AST_COMMON:
+        this->expression(AST_CAST(Ast_CommonExpression, expression)->expression);
+        break;
+    case AST_INDUCTION:
+        this->expression(AST_CAST(Ast_Induction, expression)->left);
+        this->expression(AST_CAST(Ast_Induction, expression)->right);
+        break;
+    }
+}
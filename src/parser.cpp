@@ -17,8 +17,12 @@
 
 #include "parser.h"
 #include "err.h"
+#include "scan.h"
+#include "thread_pool.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <memory>
 
 //error messages
 #define EXPECTED_ID "Expected an identifier"
@@ -31,15 +35,17 @@
 #define EXPECTED_RIGHT_PAR "Expected ')'"
 #define EXPECTED_LARROW "Expected '<'"
 #define EXPECTED_RARROW "Expected '>"
+#define EXPECTED_PATH "Expected the path of the file to import"
 
 #define UNKNOWN_TYPE "Unknown type found in variable decleration"
 #define ELIF_WITHOUT_IF "Elif without an if statement found"
 #define ELSE_WITHOUT_IF "Else without an if statement found"
 #define UNKNOWN_TOKEN "Unknown token found in expression"
 #define INVALID_LVALUE "In assignment l-value is not valid"
+#define IMPORT_IN_SCOPE "Imports are only allowed at the top level of a file"
 
 #define AST_NEW(type, ...) \
-    static_cast<type*>(default_ast(new type(__VA_ARGS__)))
+    static_cast<type*>(default_ast(root->arena.make<type>(__VA_ARGS__)))
 
 static std::map<int, int> TYPES  = {
     { Tok::T_FLOAT,   AST_FLOAT   },
@@ -49,46 +55,377 @@ static std::map<int, int> TYPES  = {
     { Tok::T_CHAR,    AST_CHAR    }
 };
 
+// How tightly each binary operator binds, weakest first. A power of 0 means the token is not a binary operator.
+enum {
+    POWER_NONE,
+    POWER_LOGICAL,
+    POWER_BITWISE,
+    POWER_EQUALITY,
+    POWER_COMPARISON,
+    POWER_SHIFT,
+    POWER_TERM,
+    POWER_FACTOR
+};
+
+struct BinaryOperator {
+    uint8_t power = POWER_NONE;
+    uint8_t op = AST_OPERATOR_NONE;
+};
+
+// Indexed by token kind, which fits in a byte.
+struct BinaryOperatorTable {
+    BinaryOperator entries[256];
+};
+
+static constexpr BinaryOperatorTable build_binary_operators() {
+    BinaryOperatorTable table = { };
+    table.entries[Tok::T_AND]           = { POWER_LOGICAL,    AST_OPERATOR_AND };
+    table.entries[Tok::T_OR]            = { POWER_LOGICAL,    AST_OPERATOR_OR };
+    table.entries[Tok::T_CARET]         = { POWER_BITWISE,    AST_OPERATOR_BIT_XOR };
+    table.entries[Tok::T_LINE]          = { POWER_BITWISE,    AST_OPERATOR_BIT_OR };
+    table.entries[Tok::T_AMBERSAND]     = { POWER_BITWISE,    AST_OPERATOR_BIT_AND };
+    table.entries[Tok::T_COMPARE_EQUAL] = { POWER_EQUALITY,   AST_OPERATOR_COMPARITIVE_EQUAL };
+    table.entries[Tok::T_NOT_EQUAL]     = { POWER_EQUALITY,   AST_OPERATOR_COMPARITIVE_NOT_EQUAL };
+    table.entries[Tok::T_LTE]           = { POWER_COMPARISON, AST_OPERATOR_LTE };
+    table.entries[Tok::T_GTE]           = { POWER_COMPARISON, AST_OPERATOR_GTE };
+    table.entries[Tok::T_LARROW]        = { POWER_COMPARISON, AST_OPERATOR_LT };
+    table.entries[Tok::T_RARROW]        = { POWER_COMPARISON, AST_OPERATOR_GT };
+    table.entries[Tok::T_BIT_LEFT]      = { POWER_SHIFT,      AST_OPERATOR_BIT_LEFT };
+    table.entries[Tok::T_BIT_RIGHT]     = { POWER_SHIFT,      AST_OPERATOR_BIT_RIGHT };
+    table.entries[Tok::T_PLUS]          = { POWER_TERM,       AST_OPERATOR_ADD };
+    table.entries[Tok::T_MINUS]         = { POWER_TERM,       AST_OPERATOR_SUB };
+    table.entries[Tok::T_STAR]          = { POWER_FACTOR,     AST_OPERATOR_MULTIPLICATIVE };
+    table.entries[Tok::T_SLASH]         = { POWER_FACTOR,     AST_OPERATOR_DIVISION };
+    table.entries[Tok::T_PERCENT]       = { POWER_FACTOR,     AST_OPERATOR_MODULO };
+    return table;
+}
+
+static constexpr BinaryOperatorTable BINARY_OPERATORS = build_binary_operators();
+
 static std::map<int, int> SPECIFIERS = {
     { Tok::T_CONSTANT, AST_SPECIFIER_CONST }
 };
 
 Ast* Parser::default_ast(Ast* ast) {
-    ast->line = peek()->line;
-    ast->file = filepath;
+    ast->line = peek()->line - origin->line;
+    ast->origin = origin;
 
     return ast;
 }
 
+// Starts the origin of a top level declaration on the line of the current token.
+void Parser::begin_origin() {
+    origin = root->arena.make<Ast_Origin>();
+    origin->file = filepath;
+    origin->line = peek()->line;
+}
+
 Parser::Parser(Lexer* lexer) {
     if (lexer) { 
-        tokens = *lexer->fetch_tokens();
+        this->lexer = lexer;
         filepath = lexer->file();
 
+        cursor = &lexer->cursor;
+        diagnostics = &lexer->diagnostics;
+
         root =  new Ast_TranslationUnit;
-        current = 0;
+        root->parser = this;
+        prime();
     }
 }
 
+/**
+ * Creates a parser for one part of a parallel parse, the tokens from begin up to end in the 
+ * lexer's store. It has its own translation unit and keeps its errors to itself.
+ */
+Parser::Parser(Lexer* lexer, TokenStore::Cursor begin, uint32_t end) : 
+    lexer(lexer), partition_cursor(begin), end(end), filepath(lexer->file()) {
+    cursor = &partition_cursor;
+    diagnostics = &partition_diagnostics;
+
+    root = new Ast_TranslationUnit;
+    prime();
+}
+
+// Reads the next token into the window slot. A parser with a part of the token store to itself 
+// sees the end of its part as the end of the file.
+Token Parser::pull(uint32_t slot) {
+    positions[slot] = *cursor;
+    if (cursor == &lexer->cursor)
+        return lexer->next();
+    if (cursor->index >= end)
+        return Token(Tok::T_EOF, lexer->tokens.line(end));
+    return lexer->tokens.read(*cursor);
+}
+
+// Fills the window with the current token and the lookahead after it.
+void Parser::prime() {
+    current = 0;
+    for (uint32_t i = 0; i < TOKEN_WINDOW - 1; i++)
+        window[i] = pull(i);
+}
+
 Parser::~Parser() {
     delete root;
 }
 
 void Parser::parse() {
+    if (incremental)
+        parse_runs();
+    else
+        parse_declerations();
+    diagnostics->flush();
+}
+
+void Parser::parse_declerations() {
     while (!is_end()) {
         auto dec = decleration();
 
         if (dec)
-            root->declerations.push_back(dec);
+            root->declerations.push_back(root->arena, dec);
+    }
+}
+
+/**
+ * Moves the cursor past one top level declaration. A declaration ends on a ';' or '}' outside of 
+ * any braces that is not followed by an elif or else. A '}' without a '{' ends one as well, a '{' 
+ * without a '}' runs to the last token, the parse reports both.
+ */
+static inline void skip_decleration(const TokenStore& tokens, TokenStore::Cursor& at, uint32_t last) {
+    uint32_t value = at.value;
+    int32_t depth = 0;
+    for (uint32_t i = at.index; i + 1 < last; i++) {
+        TokenKind kind = tokens.kind(i);
+        value += has_value(kind);
+
+        if (kind == Tok::T_LCURLY)
+            depth++;
+        else if (kind == Tok::T_RCURLY && --depth < 0) {
+            at = { i + 1, value };
+            return;
+        }
+        else if (kind != Tok::T_SEMI && kind != Tok::T_RCURLY)
+            continue;
+
+        TokenKind after = tokens.kind(i + 1);
+        if (depth == 0 && after != Tok::T_ELIF && after != Tok::T_ELSE) {
+            at = { i + 1, value };
+            return;
+        }
+    }
+
+    at = { last, (uint32_t) tokens.value_count() };
+}
+
+/**
+ * Splits the tokens from begin to the end of the store into about count runs of whole top level 
+ * declarations, see skip_decleration.
+ *
+ * @return std::vector<TokenStore::Cursor> The first token of every run, then the end of the last one.
+ */
+static std::vector<TokenStore::Cursor> partition_declerations(const TokenStore& tokens, TokenStore::Cursor begin, uint32_t count) {
+    uint32_t last = (uint32_t) tokens.size() - 1;
+    uint32_t step = (last - begin.index) / count + 1;
+
+    std::vector<TokenStore::Cursor> bounds = { begin };
+    TokenStore::Cursor at = begin;
+    while (true) {
+        skip_decleration(tokens, at, last);
+        if (at.index >= last)
+            break;
+        if (at.index >= bounds.back().index + step)
+            bounds.push_back(at);
+    }
+
+    bounds.push_back({ last, (uint32_t) tokens.value_count() });
+    return bounds;
+}
+
+/**
+ * Parses the top level declarations in parts on the thread pool, each part into its own arena, 
+ * and puts them together in source order. Needs the whole token list, without it this is parse().
+ * A part that finds an error does not know where a serial parse would have picked up again, so
+ * if any part has errors the parallel results are thrown away and the file is parsed serially,
+ * giving the same diagnostics in the same order as parse().
+ *
+ * @param uint32_t How many parts to split the declarations into.
+ */
+void Parser::parse_parallel(uint32_t partition_count) {
+    if (!lexer->lexed || cursor != &lexer->cursor || partition_count < 2) {
+        parse();
+        return;
     }
+
+    TokenStore::Cursor begin = positions[current & (TOKEN_WINDOW - 1)];
+    auto bounds = partition_declerations(lexer->tokens, begin, partition_count);
+    uint32_t count = (uint32_t) bounds.size() - 1;
+    if (count < 2) {
+        parse();
+        return;
+    }
+
+    std::vector<std::unique_ptr<Parser>> parts(count);
+    thread_pool().parallel_for(count, [&](uint32_t i) {
+        parts[i].reset(new Parser(lexer, bounds[i], bounds[i + 1].index));
+        parts[i]->lazy = lazy;
+        parts[i]->parse_declerations();
+    });
+
+    bool clean = true;
+    for (auto& part : parts)
+        clean = clean && part->diagnostics->error_count() == 0;
+
+    if (!clean) {
+        for (auto& part : parts)
+            part->diagnostics->discard();
+        parse();
+        return;
+    }
+
+    for (auto& part : parts) {
+        for (auto dec : part->root->declerations)
+            root->declerations.push_back(root->arena, dec);
+        root->arena.adopt(part->root->arena);
+        skipped += part->skipped;
+    }
+
+    *cursor = bounds.back();
+    prime();
+    diagnostics->flush();
 }
 
+/**
+ * Parses the declarations from begin up to end on their own, the way a part of a parallel parse
+ * is parsed, adding them to the list.
+ */
+Parser::Run Parser::parse_run(TokenStore::Cursor begin, uint32_t end, std::vector<Ast_Decleration*>& declerations) {
+    partition_cursor = begin;
+    this->end = end;
+    cursor = &partition_cursor;
+    prime();
+
+    Run run;
+    run.begin = begin;
+    size_t count = declerations.size();
+    size_t errors = diagnostics->error_count();
+    while (!is_end()) {
+        auto dec = decleration();
+        if (dec)
+            declerations.push_back(dec);
+    }
+
+    run.declerations = (uint32_t) (declerations.size() - count);
+    run.errors = (uint32_t) (diagnostics->error_count() - errors);
+    return run;
+}
+
+// Parses the rest of the tokens as runs, for an incremental parser.
+void Parser::parse_runs() {
+    const TokenStore& tokens = lexer->tokens;
+    uint32_t last = (uint32_t) tokens.size() - 1;
+
+    std::vector<Ast_Decleration*> declerations;
+    TokenStore::Cursor at = positions[current & (TOKEN_WINDOW - 1)];
+    while (at.index < last) {
+        TokenStore::Cursor begin = at;
+        skip_decleration(tokens, at, last);
+        runs.push_back(parse_run(begin, at.index, declerations));
+        run_errors += runs.back().errors;
+    }
+
+    root->declerations.splice(root->arena, root->declerations.size(), 0, declerations.data(), (uint32_t) declerations.size());
+}
+
+/**
+ * Brings the tree up to date with an edit of the tokens. The runs are split again from the 
+ * first one the edit could have changed, the one holding the token before it since where a
+ * run ends depends on the token after it, and each new run is parsed until one begins past 
+ * the edit where a run began before. From there on the tokens are the same and so are the 
+ * runs, the declarations of those only have their origins moved. The nodes of the declarations
+ * that were replaced stay in the arena of the unit. Errors are left in the lexer's diagnostics
+ * for the caller to flush or discard, like the ones Lexer::edit finds.
+ *
+ * @param const TokenEdit& The edit, as returned by Lexer::edit.
+ * @return uint32_t How many runs were parsed again.
+ */
+uint32_t Parser::reparse(const TokenEdit& edit) {
+    const TokenStore& tokens = lexer->tokens;
+    uint32_t last = (uint32_t) tokens.size() - 1;
+
+    uint32_t before = edit.first.index - (edit.first.index > 0);
+    size_t first = std::upper_bound(runs.begin(), runs.end(), before, [](uint32_t index, const Run& run) {
+        return index < run.begin.index;
+    }) - runs.begin();
+    first -= (first > 0);
+
+    uint32_t declerations_before = 0;
+    for (size_t i = 0; i < first; i++)
+        declerations_before += runs[i].declerations;
+
+    std::vector<Run> parsed;
+    std::vector<Ast_Decleration*> declerations;
+    TokenStore::Cursor at = (first < runs.size()) ? runs[first].begin : TokenStore::Cursor();
+    size_t old = first + 1;
+    uint32_t edit_end = edit.first.index + edit.added.index;
+    while (at.index < last) {
+        TokenStore::Cursor begin = at;
+        skip_decleration(tokens, at, last);
+        parsed.push_back(parse_run(begin, at.index, declerations));
+
+        if (at.index >= edit_end) {
+            uint32_t was = at.index - edit.added.index + edit.removed.index;
+            while (old < runs.size() && runs[old].begin.index < was)
+                old++;
+            if (old < runs.size() && runs[old].begin.index == was)
+                break;
+        }
+    }
+    if (at.index >= last)
+        old = runs.size();
+
+    uint32_t replaced = 0;
+    for (size_t i = first; i < old; i++) {
+        replaced += runs[i].declerations;
+        run_errors -= runs[i].errors;
+    }
+    for (auto& run : parsed)
+        run_errors += run.errors;
+
+    root->declerations.splice(root->arena, declerations_before, replaced, declerations.data(), (uint32_t) declerations.size());
+
+    uint32_t moved = declerations_before + (uint32_t) declerations.size();
+    for (size_t i = old; i < runs.size(); i++) {
+        runs[i].begin.index += edit.added.index - edit.removed.index;
+        runs[i].begin.value += edit.added.value - edit.removed.value;
+    }
+    if (edit.lines != 0) {
+        for (uint32_t i = moved; i < root->declerations.size(); i++)
+            root->declerations[i]->origin->line += edit.lines;
+    }
+
+    runs.erase(runs.begin() + first, runs.begin() + old);
+    runs.insert(runs.begin() + first, parsed.begin(), parsed.end());
+    return (uint32_t) parsed.size();
+}
+
+/**
+ * Looks at a token relative to the current one. Only the previous token (-1) up to
+ * two tokens ahead (2) are kept, and the pointer is only good until the next advance.
+ * 
+ * @param int The offset from the current token.
+ * @return Token* The token.
+ */
 Token* Parser::peek(int index) {
-    return &tokens[current + index];
+    return &window[(current + index) & (TOKEN_WINDOW - 1)];
 }
 
 Token* Parser::advance() {
-    return ((!is_end()) ? &tokens[current++] : &tokens[current]);
+    if (is_end())
+        return peek();
+
+    current++;
+    *peek(TOKEN_WINDOW - 2) = pull((current + TOKEN_WINDOW - 2) & (TOKEN_WINDOW - 1));
+    return peek(-1);
 }
 
 bool Parser::match(int type) {
@@ -105,91 +442,147 @@ bool Parser::check(int type) {
 
 Token* Parser::consume(int type, const char* msg) {
     if (check(type)) return advance();
-    throw parser_error(peek(), msg);
+    return parser_error(peek(), msg);
 }
 
-ParserError Parser::parser_error(Token* token, const char* msg) {
-    report_error("In file '%s', on line %d: '%s'.\n", filepath, token->line, msg);
-    return ParserError(token);
+/**
+ * Hands the error to the lexer's diagnostics and gives back the nullptr that the parse 
+ * functions return to say they failed, so a failing function can end with return parser_error(...).
+ */
+std::nullptr_t Parser::parser_error(Token* token, const char* msg) {
+    diagnostics->error(filepath, token->line, msg);
+    return nullptr;
 }
 
 bool Parser::is_end() {
-    return (current == tokens.size() - 1);
+    return (peek()->type == Tok::T_EOF);
 }
 
+/**
+ * Every parse function below returns nullptr once it has reported an error and its caller 
+ * passes that straight on, without reading any more tokens, up to here where the parser 
+ * skips ahead to a point it can carry on from.
+ */
 Ast_Decleration* Parser::decleration() {
-    try {
-        if (peek()->type == Tok::T_IDENTIFIER && peek(1)->type == Tok::T_COLON) {
-            if (peek(2)->type == Tok::T_FUNC)
-                return func_decleration();
-            return var_decleration();
-        }
-        return statement();
-    }
-    catch (ParserError error) {
+    if (scope_depth == 0)
+        begin_origin();
+
+    Ast_Decleration* dec;
+    if (peek()->type == Tok::T_IDENTIFIER && peek(1)->type == Tok::T_COLON)
+        dec = (peek(2)->type == Tok::T_FUNC) ? (Ast_Decleration*) func_decleration() : var_decleration();
+    else if (peek()->type == Tok::T_IMPORT)
+        dec = import_decleration();
+    else
+        dec = statement();
+
+    if (!dec)
         synchronize();
-        return nullptr;
-    }
+    return dec;
+}
+
+Ast_ImportDecleration* Parser::import_decleration() {
+    uint32_t line = advance()->line;
+    if (scope_depth > 0) return parser_error(peek(-1), IMPORT_IN_SCOPE);
+
+    if (!consume(Tok::T_STRING_CONST, EXPECTED_PATH)) return nullptr;
+    const char* path = string_const(peek(-1));
+    if (!consume(Tok::T_SEMI, EXPECTED_SEMI)) return nullptr;
+
+    auto import = AST_NEW(Ast_ImportDecleration, path);
+    import->line = line - origin->line;
+    return import;
 }
 
 Ast_FuncDecleration* Parser::func_decleration() {
-    consume(Tok::T_IDENTIFIER, EXPECTED_ID);
-    auto id = peek(-1)->identifier;
-    consume(Tok::T_COLON, EXPECTED_COLON);
+    if (!consume(Tok::T_IDENTIFIER, EXPECTED_ID)) return nullptr;
+    auto id = peek(-1)->symbol;
+    if (!consume(Tok::T_COLON, EXPECTED_COLON)) return nullptr;
 
-    consume(Tok::T_FUNC, EXPECTED_FUNC);
+    if (!consume(Tok::T_FUNC, EXPECTED_FUNC)) return nullptr;
 
-    auto args = func_args();
+    Ast_List<Ast_VarDecleration*> args;
+    if (!func_args(args)) return nullptr;
 
     int return_type = AST_VOID;
     if (match(Tok::T_DASH_ARROW)) {
         if (TYPES.find(peek()->type) != TYPES.end()) {
-            return_type = TYPES[peek()->type];
+            return_type = TYPES.at(peek()->type);
             match(peek()->type);
         }
         else
-            throw parser_error(peek(), UNKNOWN_TYPE);
+            return parser_error(peek(), UNKNOWN_TYPE);
+    }
+
+    if (!consume(Tok::T_LCURLY, EXPECTED_LEFT_CURLY)) return nullptr;
+    if (lazy) {
+        TokenStore::Cursor body = positions[current & (TOKEN_WINDOW - 1)];
+        if (!skip_scope()) return nullptr;
+        skipped++;
+
+        auto func = AST_NEW(Ast_FuncDecleration, id, return_type, args, nullptr);
+        func->body = body;
+        return func;
     }
 
-    consume(Tok::T_LCURLY, EXPECTED_LEFT_CURLY);
     auto s = scope();
+    if (!s) return nullptr;
 
     return AST_NEW(Ast_FuncDecleration, id, return_type, args, s);
 }
 
-std::vector<Ast_VarDecleration*> Parser::func_args() {
-    std::vector<Ast_VarDecleration*> args;
-    consume(Tok::T_LPAR, EXPECTED_LEFT_PAR);
+/**
+ * Parses the body of a function that was skipped over, on the first call to it. The parser is
+ * pointed back at the first token of the body and parses it the way it would have the first time.
+ * Errors in the body are reported right away.
+ *
+ * @param Ast_FuncDecleration* The function, its scope is filled in.
+ * @return Ast_Scope* The body, or nullptr if it has errors.
+ */
+Ast_Scope* Parser::parse_body(Ast_FuncDecleration* func) {
+    *cursor = func->body;
+    prime();
+    origin = func->origin;
+
+    func->scope = scope();
+    diagnostics->flush();
+    return func->scope;
+}
+
+bool Parser::func_args(Ast_List<Ast_VarDecleration*>& args) {
+    if (!consume(Tok::T_LPAR, EXPECTED_LEFT_PAR)) return false;
     if (match(Tok::T_RPAR))
-        return args;
+        return true;
 
-    args.push_back(var_decleration(false));
-    while (match(Tok::T_COMMA)) {
-        args.push_back(var_decleration(false));
-    }
+    do {
+        auto arg = var_decleration(false);
+        if (!arg) return false;
+        args.push_back(root->arena, arg);
+    } while (match(Tok::T_COMMA));
 
-    consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR);
-    return args;
+    return consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR) != nullptr;
 }
 
 Ast_VarDecleration* Parser::var_decleration(bool semi) {
-    consume(Tok::T_IDENTIFIER, EXPECTED_ID);
-    auto id = peek(-1)->identifier;
-    consume(Tok::T_COLON, EXPECTED_COLON);
+    if (!consume(Tok::T_IDENTIFIER, EXPECTED_ID)) return nullptr;
+    auto id = peek(-1)->symbol;
+    if (!consume(Tok::T_COLON, EXPECTED_COLON)) return nullptr;
 
     int specifiers = AST_SPECIFIER_NONE;
     if (SPECIFIERS.find(peek()->type) != SPECIFIERS.end()) {
-        specifiers = SPECIFIERS[peek()->type];
+        specifiers = SPECIFIERS.at(peek()->type);
         match(peek()->type);
     }
 
     int var_type = type();
+    if (var_type == AST_TYPE_NONE) return nullptr;
 
+    // No initializer is fine, a failed one is not.
     Ast_Expression* expr = nullptr;
-    if (match(Tok::T_EQUAL))
+    if (match(Tok::T_EQUAL)) {
         expr = expression();
-    expr = (!expr) ? nullptr : expr;
-    if (semi) consume(Tok::T_SEMI, EXPECTED_SEMI);
+        if (!expr) return nullptr;
+    }
+    if (semi && !consume(Tok::T_SEMI, EXPECTED_SEMI)) return nullptr;
 
     return AST_NEW(Ast_VarDecleration, id, expr, var_type, specifiers);
 }
@@ -198,8 +591,8 @@ Ast_Statement* Parser::statement() {
     //***********************REFACTOR***********************//
     if (match(Tok::T_PRINT)) return print_statement();
     else if (match(Tok::T_IF)) return conditional_statement();
-    else if (match(Tok::T_ELIF)) throw parser_error(peek(), ELIF_WITHOUT_IF);
-    else if (match(Tok::T_ELSE)) throw parser_error(peek(), ELSE_WITHOUT_IF);
+    else if (match(Tok::T_ELIF)) return parser_error(peek(), ELIF_WITHOUT_IF);
+    else if (match(Tok::T_ELSE)) return parser_error(peek(), ELSE_WITHOUT_IF);
     else if (match(Tok::T_LCURLY)) return scope();
     else if (match(Tok::T_WHILE)) return while_loop();
     else if (match(Tok::T_RETURN)) return return_statement();
@@ -211,118 +604,167 @@ Ast_ReturnStatement* Parser::return_statement() {
     if (match(Tok::T_SEMI))
         return AST_NEW(Ast_ReturnStatement, nullptr);
     auto expr = expression();
-    consume(Tok::T_SEMI, EXPECTED_SEMI);
+    if (!expr) return nullptr;
+    if (!consume(Tok::T_SEMI, EXPECTED_SEMI)) return nullptr;
 
     return AST_NEW(Ast_ReturnStatement, expr);
 }
 
 Ast_ConditionalStatement* Parser::conditional_statement() {
     auto if_state = if_statement();
+    if (!if_state) return nullptr;
 
     Ast_ConditionalStatement* current = if_state;
     while (match(Tok::T_ELIF)) {
         current->next = elif_statement();
         current = current->next;
+        if (!current) return nullptr;
     }
 
-    if (match(Tok::T_ELSE)) 
+    if (match(Tok::T_ELSE)) {
         current->next = else_statement();
+        if (!current->next) return nullptr;
+    }
 
     return if_state;
 } 
 
 Ast_IfStatement* Parser::if_statement() {
-    Ast_Scope* s;
-    Ast_Expression* expr;
-    
-    expr = expression();
-    if (match(Tok::T_LCURLY)) {
-        s = scope();
-    }
-    else {
-        s = AST_NEW(Ast_Scope);
-        s->declerations.push_back(statement());
-    }
+    auto expr = expression();
+    if (!expr) return nullptr;
+    auto s = body();
+    if (!s) return nullptr;
     
     return AST_NEW(Ast_IfStatement, expr, s);
 }
 
 Ast_ElifStatement* Parser::elif_statement() {
-    Ast_Scope* s;
-    Ast_Expression* expr;
-    
-    expr = expression();
-    if (match(Tok::T_LCURLY)) {
-        s = scope();
-    }
-    else {
-        s = AST_NEW(Ast_Scope);
-        s->declerations.push_back(statement());
-    }
+    auto expr = expression();
+    if (!expr) return nullptr;
+    auto s = body();
+    if (!s) return nullptr;
+
     return AST_NEW(Ast_ElifStatement, expr, s);
 }
 
 Ast_ElseStatement* Parser::else_statement() {
-    Ast_Scope* s;
-    if (match(Tok::T_LCURLY)) {
-        s = scope();
-    }
-    else {
-        s = AST_NEW(Ast_Scope);
-        s->declerations.push_back(statement());
-    }
+    auto s = body();
+    if (!s) return nullptr;
+
     return AST_NEW(Ast_ElseStatement, s);
 }
 
 //Does not consume or match LCURLY!
 Ast_Scope* Parser::scope() {
     Ast_Scope* s = AST_NEW(Ast_Scope);
+    scope_depth++;
     while (!check(Tok::T_RCURLY) && !is_end()) {
-        s->declerations.push_back(decleration());
+        // A declaration that failed has already been reported and skipped over.
+        auto dec = decleration();
+        if (dec)
+            s->declerations.push_back(root->arena, dec);
     }
+    scope_depth--;
 
-    consume(Tok::T_RCURLY, EXPECTED_RIGHT_CURLY);
+    if (!consume(Tok::T_RCURLY, EXPECTED_RIGHT_CURLY)) return nullptr;
     return s;
 }
 
-Ast_WhileLoop* Parser::while_loop() {
-    Ast_Scope* s;
-    Ast_Expression* expr;
-    
-    expr = expression();
-    if (match(Tok::T_LCURLY)) {
-        s = scope();
-    }
-    else {
-        s = AST_NEW(Ast_Scope);
-        s->declerations.push_back(statement());
+/**
+ * Skips to just past the '}' that closes the current scope, building nothing. The braces are
+ * matched by walking the token kinds in the lexer's store rather than the window, which is then
+ * primed again from the closing brace.
+ */
+bool Parser::skip_scope() {
+    const TokenStore& tokens = lexer->tokens;
+    TokenStore::Cursor at = positions[current & (TOKEN_WINDOW - 1)];
+
+    uint32_t depth = 1;
+    for (uint32_t last = std::min((uint32_t) tokens.size() - 1, end); at.index < last; at.index++) {
+        TokenKind kind = tokens.kind(at.index);
+        if (kind == Tok::T_LCURLY)
+            depth++;
+        else if (kind == Tok::T_RCURLY && --depth == 0)
+            break;
+        at.value += has_value(kind);
     }
+
+    *cursor = at;
+    prime();
+    return consume(Tok::T_RCURLY, EXPECTED_RIGHT_CURLY) != nullptr;
+}
+
+// The body of an if, elif, else or while, either a scope or a single statement.
+Ast_Scope* Parser::body() {
+    if (match(Tok::T_LCURLY))
+        return scope();
+
+    Ast_Scope* s = AST_NEW(Ast_Scope);
+    auto statement = this->statement();
+    if (!statement) return nullptr;
+    s->declerations.push_back(root->arena, statement);
+    return s;
+}
+
+Ast_WhileLoop* Parser::while_loop() {
+    auto expr = expression();
+    if (!expr) return nullptr;
+    auto s = body();
+    if (!s) return nullptr;
+
     return AST_NEW(Ast_WhileLoop, expr, s);
 }
 
 Ast_ExpressionStatement* Parser::expression_statement() {
     auto expr = expression();
-    consume(Tok::T_SEMI, EXPECTED_SEMI);
+    if (!expr) return nullptr;
+    if (!consume(Tok::T_SEMI, EXPECTED_SEMI)) return nullptr;
     return AST_NEW(Ast_ExpressionStatement, expr);
 }
 
 Ast_PrintStatement* Parser::print_statement() {
-    std::vector<Ast_Expression*> expressions;
-    expressions.push_back(expression());
-
-    while (match(Tok::T_COMMA)) 
-        expressions.push_back(expression());
+    Ast_List<Ast_Expression*> expressions;
+    do {
+        auto expr = expression();
+        if (!expr) return nullptr;
+        expressions.push_back(root->arena, expr);
+    } while (match(Tok::T_COMMA));
 
-    consume(Tok::T_SEMI, EXPECTED_SEMI);
+    if (!consume(Tok::T_SEMI, EXPECTED_SEMI)) return nullptr;
     return AST_NEW(Ast_PrintStatement, expressions);
 }
 
+/**
+ * Skips the tokens after an error up to where the next declaration can start: just past a ';', 
+ * on the '}' that closes the scope being parsed, on a keyword that begins a statement or on an 
+ * 'id :'. At least one token is skipped unless the parser is already sitting on the closing '}' 
+ * of a scope, which is left for scope() to take.
+ */
 void Parser::synchronize() {
+    if (check(Tok::T_RCURLY) && scope_depth > 0)
+        return;
     advance();
 
     while (!is_end()) {
         if (peek(-1)->type == Tok::T_SEMI) return;
 
+        switch (peek()->type) {
+        case Tok::T_RCURLY:
+            if (scope_depth > 0) return;
+            break;
+        case Tok::T_IF:
+        case Tok::T_WHILE:
+        case Tok::T_PRINT:
+        case Tok::T_RETURN:
+        case Tok::T_IMPORT:
+            return;
+        case Tok::T_IDENTIFIER:
+            if (peek(1)->type == Tok::T_COLON) return;
+            break;
+        default:
+            break;
+        }
+
         advance();
     }   
 }
@@ -332,114 +774,63 @@ Ast_Expression* Parser::expression() {
 }
 
 Ast_Expression* Parser::assignment() {
-    auto expr = logical();
+    auto expr = binary(POWER_LOGICAL);
+    if (!expr) return nullptr;
 
-    if (match(Tok::T_EQUAL) || match(Tok::T_EQUAL_PLUS) || match(Tok::T_EQUAL_MINUS) || 
-        match(Tok::T_EQUAL_STAR) || match(Tok::T_EQUAL_SLASH) || match(Tok::T_EQUAL_MOD)) {
-        Token* equal = peek(-1);
+    int equal_type = token_to_equal(peek());
+    if (equal_type != -1) {
+        Token equal = *advance();
         auto val = assignment();
+        if (!val) return nullptr;
 
         if (expr->type == AST_PRIMARY && AST_CAST(Ast_PrimaryExpression, expr)->type_value == AST_ID) 
-            return AST_NEW(Ast_Assignment, val, AST_CAST(Ast_PrimaryExpression, expr)->ident, token_to_equal(equal));
-    
-        parser_error(equal, INVALID_LVALUE);
-    }
-
-    return expr;
-}
-
-Ast_Expression* Parser::logical() {
-    auto expr = bitwise();
-
-    while (match(Tok::T_AND) || match(Tok::T_OR)) {
-        auto tok = tokens[current - 1];
-        auto right = bitwise();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);      
-    }
-
-    return expr;
-}
-
-Ast_Expression* Parser::bitwise() {
-    auto expr = equality();
+            return AST_NEW(Ast_Assignment, val, AST_CAST(Ast_PrimaryExpression, expr)->ident, equal_type);
     
-    while (match(Tok::T_CARET) || match(Tok::T_LINE) || match(Tok::T_AMBERSAND)) {
-        auto tok = tokens[current - 1];
-        auto right = equality();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);
-    }
-    
-    return expr;
-}
-
-Ast_Expression* Parser::equality() {
-    auto expr = comparison();
-
-    while (match(Tok::T_COMPARE_EQUAL) || match(Tok::T_NOT_EQUAL)) {
-        auto tok = tokens[current - 1];
-        auto right = comparison();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);
-    }
-
-    return expr;
-}
-
-Ast_Expression* Parser::comparison() {
-    auto expr = shifts();
-
-    while (match(Tok::T_LTE) || match(Tok::T_GTE) || match(Tok::T_LARROW) || match(Tok::T_RARROW)) {
-        auto tok = tokens[current - 1];
-        auto right = shifts();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);
+        parser_error(&equal, INVALID_LVALUE);
     }
 
     return expr;
 }
 
-Ast_Expression* Parser::shifts() {
-    auto expr = term();
-
-    while (match(Tok::T_BIT_LEFT) || match(Tok::T_BIT_RIGHT)) {
-        auto tok = tokens[current - 1];
-        auto right = term();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);
-    }
-
-    return expr;
-}
-
-Ast_Expression* Parser::term() {
-    auto expr = factor();
-
-    while (match(Tok::T_PLUS) || match(Tok::T_MINUS)) {
-        auto tok = tokens[current - 1];
-        auto right = factor();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);
-    }
+/**
+ * Parses a chain of binary operators with the precedence climbing (Pratt) method. Operands are 
+ * parsed by unary() and every operator at least as strong as min_power is folded in from the 
+ * left, its right side only taking the operators that bind tighter than it does.
+ * 
+ * @param uint8_t The weakest binding power this call may take.
+ * @return Ast_Expression* The expression.
+ */
+Ast_Expression* Parser::binary(uint8_t min_power) {
+    auto expr = unary();
+    if (!expr) return nullptr;
 
-    return expr;
-}
+    while (true) {
+        const BinaryOperator& op = BINARY_OPERATORS.entries[peek()->type];
+        if (op.power < min_power)
+            break;
 
-Ast_Expression* Parser::factor() {
-    auto expr = unary();
-    
-    while (match(Tok::T_SLASH) || match(Tok::T_STAR) || match(Tok::T_PERCENT)) {
-        auto tok = tokens[current - 1];
-        auto right = unary();
-        expr = AST_NEW(Ast_BinaryExpression, expr, token_to_ast(&tok), right);
+        advance();
+        auto right = binary(op.power + 1);
+        if (!right) return nullptr;
+        expr = AST_NEW(Ast_BinaryExpression, expr, op.op, right);
     }
 
     return expr;
 }
 
 Ast_Expression* Parser::unary() {
-    if (match(Tok::T_MINUS) || match(Tok::T_EXCLAMATION) || match(Tok::T_NOT)) {
-        auto tok = tokens[current - 1];
+    switch (peek()->type) {
+    case Tok::T_MINUS:
+    case Tok::T_EXCLAMATION:
+    case Tok::T_NOT: {
+        auto tok = *advance();
         Ast_Expression* right = unary();
+        if (!right) return nullptr;
         return AST_NEW(Ast_UnaryExpression, right, token_to_ast_unary(&tok));
     }
-
-    return primary();
+    default:
+        return primary();
+    }
 }
 
 Ast_Expression* Parser::primary() {
@@ -476,24 +867,23 @@ Ast_Expression* Parser::primary() {
         break;
     }
     case Tok::T_IDENTIFIER: {
-        const char* ident = peek()->identifier;
+        SymbolId ident = peek()->symbol;
         match(Tok::T_IDENTIFIER);
 
         prime->type_value = (peek()->type == Tok::T_LPAR) ? AST_FUNC_CALL : AST_ID;
         if (prime->type_value == AST_FUNC_CALL) {
-            std::vector<Ast_Expression*> args;
-            consume(Tok::T_LPAR, EXPECTED_LEFT_PAR);
+            Ast_List<Ast_Expression*> args;
+            match(Tok::T_LPAR);
 
             if (!check(Tok::T_RPAR)) {
-                args.push_back(expression());
-                while (match(Tok::T_COMMA)) {
-                    args.push_back(expression());
-                }
-                consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR);
+                do {
+                    auto arg = expression();
+                    if (!arg) return nullptr;
+                    args.push_back(root->arena, arg);
+                } while (match(Tok::T_COMMA));
             }
-            else 
-                consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR);
-            prime->call = new Ast_FunctionCall(ident, args);
+            if (!consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR)) return nullptr;
+            prime->call = root->arena.make<Ast_FunctionCall>(ident, args);
         }
         else {
             prime->ident = ident;
@@ -503,12 +893,14 @@ Ast_Expression* Parser::primary() {
     }
     case Tok::T_CAST: {
         match(Tok::T_CAST);
-        consume(Tok::T_LARROW, EXPECTED_LARROW);
+        if (!consume(Tok::T_LARROW, EXPECTED_LARROW)) return nullptr;
         int t = type();
-        consume(Tok::T_RARROW, EXPECTED_RARROW);
-        consume(Tok::T_LPAR, EXPECTED_LEFT_PAR);
+        if (t == AST_TYPE_NONE) return nullptr;
+        if (!consume(Tok::T_RARROW, EXPECTED_RARROW)) return nullptr;
+        if (!consume(Tok::T_LPAR, EXPECTED_LEFT_PAR)) return nullptr;
         auto expr = expression();
-        consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR);
+        if (!expr) return nullptr;
+        if (!consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR)) return nullptr;
 
         prime->cast.cast_type = t;
         prime->cast.expression = expr;
@@ -519,13 +911,14 @@ Ast_Expression* Parser::primary() {
     case Tok::T_LPAR: {
         match(Tok::T_LPAR);
         auto expr = expression();
+        if (!expr) return nullptr;
         match(Tok::T_RPAR);
         prime->nested = expr;
         prime->type_value = AST_NESTED;
         break;
     }
     case Tok::T_STRING_CONST: {
-        prime->string = peek()->string;
+        prime->string = string_const(peek());
         prime->type_value = AST_STRING;
         match(Tok::T_STRING_CONST);
         break;
@@ -533,43 +926,19 @@ Ast_Expression* Parser::primary() {
     case Tok::T_INPUT: {
         prime->type_value = AST_INPUT;
         match(Tok::T_INPUT);
-        consume(Tok::T_LPAR, EXPECTED_LEFT_PAR);
+        if (!consume(Tok::T_LPAR, EXPECTED_LEFT_PAR)) return nullptr;
         prime->input_type = type();
-        consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR);
+        if (prime->input_type == AST_TYPE_NONE) return nullptr;
+        if (!consume(Tok::T_RPAR, EXPECTED_RIGHT_PAR)) return nullptr;
         break;
     }
     default:
-    printf("OH NO: %d\n", peek()->type);
-        parser_error(peek(), UNKNOWN_TOKEN);
+        return parser_error(peek(), UNKNOWN_TOKEN);
     }
 
     return prime;
 }
 
-int Parser::token_to_ast(Token* token) {
-    switch (token->type) {
-    case Tok::T_COMPARE_EQUAL: return AST_OPERATOR_COMPARITIVE_EQUAL;
-    case Tok::T_NOT_EQUAL:     return AST_OPERATOR_COMPARITIVE_NOT_EQUAL;
-    case Tok::T_LTE:           return AST_OPERATOR_LTE;
-    case Tok::T_GTE:           return AST_OPERATOR_GTE;
-    case Tok::T_LARROW:        return AST_OPERATOR_LT;
-    case Tok::T_RARROW:        return AST_OPERATOR_GT;
-    case Tok::T_PLUS:          return AST_OPERATOR_ADD;
-    case Tok::T_MINUS:         return AST_OPERATOR_SUB;
-    case Tok::T_STAR:          return AST_OPERATOR_MULTIPLICATIVE;
-    case Tok::T_SLASH:         return AST_OPERATOR_DIVISION;
-    case Tok::T_AND:           return AST_OPERATOR_AND;
-    case Tok::T_OR:            return AST_OPERATOR_OR;
-    case Tok::T_PERCENT:       return AST_OPERATOR_MODULO;
-    case Tok::T_AMBERSAND:     return AST_OPERATOR_BIT_AND;
-    case Tok::T_LINE:          return AST_OPERATOR_BIT_OR;
-    case Tok::T_CARET:         return AST_OPERATOR_BIT_XOR;
-    case Tok::T_BIT_LEFT:      return AST_OPERATOR_BIT_LEFT;
-    case Tok::T_BIT_RIGHT:     return AST_OPERATOR_BIT_RIGHT;
-    }
-    return -1;
-}
-
 int Parser::token_to_ast_unary(Token* token) {
     switch (token->type) {
     case Tok::T_EXCLAMATION: return AST_UNARY_NOT;
@@ -591,13 +960,51 @@ int Parser::token_to_equal(Token* token) {
     return -1;
 }
 
+/**
+ * Decodes the escape sequences of a string constant into a null terminated copy
+ * that the ast can hold on to.
+ *
+ * @param Token* The string constant token.
+ * @return const char* The decoded string.
+ */
+const char* Parser::string_const(Token* token) {
+    std::string_view text = lexer->text(*token);
+    char* string = root->arena.make_array<char>(text.size() + 1);
+
+    // The text between backslashes is copied in one go, so this is a single pass over the string.
+    uint32_t size = (uint32_t) text.size();
+    uint32_t i = 0;
+    size_t length = 0;
+    while (i < size) {
+        uint32_t slash = find_byte(text.data(), i, size, '\\');
+        memcpy(string + length, text.data() + i, slash - i);
+        length += slash - i;
+        if (slash == size)
+            break;
+
+        char next = (slash + 1 < size) ? text[slash + 1] : '\0';
+        if (next == 'n' || next == '\\') {
+            string[length++] = (next == 'n') ? '\n' : '\\';
+            i = slash + 2;
+        }
+        else {
+            string[length++] = '\\';
+            i = slash + 1;
+        }
+    }
+    string[length] = '\0';
+
+    return string;
+}
+
+// Returns AST_TYPE_NONE after reporting an error if the current token is not a type.
 int Parser::type() {
     int var_type = AST_TYPE_NONE;
     if (TYPES.find(peek()->type) != TYPES.end()) {
-        var_type = TYPES[peek()->type];
+        var_type = TYPES.at(peek()->type);
         match(peek()->type);
         return var_type;
     }
-    else
-        throw parser_error(peek(), UNKNOWN_TYPE);
+    parser_error(peek(), UNKNOWN_TYPE);
+    return AST_TYPE_NONE;
 }
\ No newline at end of file
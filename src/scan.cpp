@@ -0,0 +1,299 @@
+/**
+ * @file scan.cpp
+ * @author strah19
+ * @date July 12 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * SSE2 and AVX2 routines that let the lexer skip whitespace, comments and
+ * string bodies many bytes at a time.
+ */
+
+#include "scan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions marked for it, MSVC always can.
+#if defined(SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+static inline uint32_t lowest_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t) index;
+#else
+    return (uint32_t) __builtin_ctz(mask);
+#endif
+}
+
+static inline uint32_t bit_count(uint32_t mask) {
+#ifdef _MSC_VER
+    uint32_t count = 0;
+    for (; mask; mask &= mask - 1)
+        count++;
+    return count;
+#else
+    return (uint32_t) __builtin_popcount(mask);
+#endif
+}
+
+// Space, \t, \n, \v, \f and \r, the same set the lexer's character classes treat as whitespace.
+static inline bool is_space(char c) {
+    return c == ' ' || ((uint8_t) c - 9u) <= 4u;
+}
+
+static uint32_t skip_whitespace_scalar(const char* data, uint32_t index, uint32_t end, uint32_t& lines) {
+    while (index < end && is_space(data[index])) {
+        if (data[index] == '\n')
+            lines++;
+        index++;
+    }
+    return index;
+}
+
+static uint32_t find_byte_scalar(const char* data, uint32_t index, uint32_t end, char c) {
+    const void* found = memchr(data + index, c, end - index);
+    return found ? (uint32_t) ((const char*) found - data) : end;
+}
+
+static uint32_t find_either_scalar(const char* data, uint32_t index, uint32_t end, char a, char b, uint32_t& lines) {
+    while (index < end && data[index] != a && data[index] != b) {
+        if (data[index] == '\n')
+            lines++;
+        index++;
+    }
+    return index;
+}
+
+static uint32_t count_any_scalar(const char* data, uint32_t index, uint32_t end, const char* set, uint32_t count) {
+    uint32_t found = 0;
+    for (; index < end; index++) {
+        for (uint32_t i = 0; i < count; i++)
+            found += (data[index] == set[i]);
+    }
+    return found;
+}
+
+#ifdef SCAN_X86
+
+// Whitespace is a space or a byte from 9 to 13. Subtracting 9 moves that range to 0..4 where
+// an unsigned min with 4 leaves it unchanged.
+static inline __m128i whitespace_sse2(__m128i chunk) {
+    __m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8(9));
+    __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    return _mm_or_si128(in_range, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+}
+
+static uint32_t skip_whitespace_sse2(const char* data, uint32_t index, uint32_t end, uint32_t& lines) {
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (index + 16 <= end) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + index));
+        uint32_t other = ~(uint32_t) _mm_movemask_epi8(whitespace_sse2(chunk)) & 0xFFFF;
+        uint32_t newlines = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (other) {
+            uint32_t at = lowest_bit(other);
+            lines += bit_count(newlines & ((1u << at) - 1));
+            return index + at;
+        }
+        lines += bit_count(newlines);
+        index += 16;
+    }
+    return skip_whitespace_scalar(data, index, end, lines);
+}
+
+static uint32_t find_byte_sse2(const char* data, uint32_t index, uint32_t end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+
+    while (index + 16 <= end) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + index));
+        uint32_t found = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (found)
+            return index + lowest_bit(found);
+        index += 16;
+    }
+    return find_byte_scalar(data, index, end, c);
+}
+
+static uint32_t find_either_sse2(const char* data, uint32_t index, uint32_t end, char a, char b, uint32_t& lines) {
+    const __m128i first = _mm_set1_epi8(a);
+    const __m128i second = _mm_set1_epi8(b);
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (index + 16 <= end) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + index));
+        uint32_t found = (uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, first), _mm_cmpeq_epi8(chunk, second)));
+        uint32_t newlines = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (found) {
+            uint32_t at = lowest_bit(found);
+            lines += bit_count(newlines & ((1u << at) - 1));
+            return index + at;
+        }
+        lines += bit_count(newlines);
+        index += 16;
+    }
+    return find_either_scalar(data, index, end, a, b, lines);
+}
+
+static uint32_t count_any_sse2(const char* data, uint32_t index, uint32_t end, const char* set, uint32_t count) {
+    __m128i needles[8];
+    for (uint32_t i = 0; i < count; i++)
+        needles[i] = _mm_set1_epi8(set[i]);
+
+    uint32_t found = 0;
+    while (index + 16 <= end) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + index));
+        __m128i any = _mm_setzero_si128();
+        for (uint32_t i = 0; i < count; i++)
+            any = _mm_or_si128(any, _mm_cmpeq_epi8(chunk, needles[i]));
+        found += bit_count((uint32_t) _mm_movemask_epi8(any));
+        index += 16;
+    }
+    return found + count_any_scalar(data, index, end, set, count);
+}
+
+TARGET_AVX2 static inline __m256i whitespace_avx2(__m256i chunk) {
+    __m256i shifted = _mm256_sub_epi8(chunk, _mm256_set1_epi8(9));
+    __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+    return _mm256_or_si256(in_range, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')));
+}
+
+TARGET_AVX2 static uint32_t skip_whitespace_avx2(const char* data, uint32_t index, uint32_t end, uint32_t& lines) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    while (index + 32 <= end) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + index));
+        uint32_t other = ~(uint32_t) _mm256_movemask_epi8(whitespace_avx2(chunk));
+        uint32_t newlines = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        if (other) {
+            uint32_t at = lowest_bit(other);
+            lines += bit_count(newlines & ((1u << at) - 1));
+            return index + at;
+        }
+        lines += bit_count(newlines);
+        index += 32;
+    }
+    return skip_whitespace_sse2(data, index, end, lines);
+}
+
+TARGET_AVX2 static uint32_t find_byte_avx2(const char* data, uint32_t index, uint32_t end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    while (index + 32 <= end) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + index));
+        uint32_t found = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (found)
+            return index + lowest_bit(found);
+        index += 32;
+    }
+    return find_byte_sse2(data, index, end, c);
+}
+
+TARGET_AVX2 static uint32_t find_either_avx2(const char* data, uint32_t index, uint32_t end, char a, char b, uint32_t& lines) {
+    const __m256i first = _mm256_set1_epi8(a);
+    const __m256i second = _mm256_set1_epi8(b);
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    while (index + 32 <= end) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + index));
+        uint32_t found = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, first), _mm256_cmpeq_epi8(chunk, second)));
+        uint32_t newlines = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        if (found) {
+            uint32_t at = lowest_bit(found);
+            lines += bit_count(newlines & ((1u << at) - 1));
+            return index + at;
+        }
+        lines += bit_count(newlines);
+        index += 32;
+    }
+    return find_either_sse2(data, index, end, a, b, lines);
+}
+
+TARGET_AVX2 static uint32_t count_any_avx2(const char* data, uint32_t index, uint32_t end, const char* set, uint32_t count) {
+    __m256i needles[8];
+    for (uint32_t i = 0; i < count; i++)
+        needles[i] = _mm256_set1_epi8(set[i]);
+
+    uint32_t found = 0;
+    while (index + 32 <= end) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + index));
+        __m256i any = _mm256_setzero_si256();
+        for (uint32_t i = 0; i < count; i++)
+            any = _mm256_or_si256(any, _mm256_cmpeq_epi8(chunk, needles[i]));
+        found += bit_count((uint32_t) _mm256_movemask_epi8(any));
+        index += 32;
+    }
+    return found + count_any_sse2(data, index, end, set, count);
+}
+
+static bool has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+struct ScanRoutines {
+    const char* isa;
+    uint32_t (*skip_whitespace)(const char*, uint32_t, uint32_t, uint32_t&);
+    uint32_t (*find_byte)(const char*, uint32_t, uint32_t, char);
+    uint32_t (*find_either)(const char*, uint32_t, uint32_t, char, char, uint32_t&);
+    uint32_t (*count_any)(const char*, uint32_t, uint32_t, const char*, uint32_t);
+};
+
+static ScanRoutines select_routines() {
+#ifdef SCAN_X86
+    if (has_avx2())
+        return { "AVX2", skip_whitespace_avx2, find_byte_avx2, find_either_avx2, count_any_avx2 };
+    return { "SSE2", skip_whitespace_sse2, find_byte_sse2, find_either_sse2, count_any_sse2 };
+#else
+    return { "scalar", skip_whitespace_scalar, find_byte_scalar, find_either_scalar, count_any_scalar };
+#endif
+}
+
+static const ScanRoutines ROUTINES = select_routines();
+
+uint32_t skip_whitespace(const char* data, uint32_t index, uint32_t end, uint32_t& lines) {
+    return ROUTINES.skip_whitespace(data, index, end, lines);
+}
+
+uint32_t find_byte(const char* data, uint32_t index, uint32_t end, char c) {
+    return ROUTINES.find_byte(data, index, end, c);
+}
+
+uint32_t find_either(const char* data, uint32_t index, uint32_t end, char a, char b, uint32_t& lines) {
+    return ROUTINES.find_either(data, index, end, a, b, lines);
+}
+
+uint32_t count_any(const char* data, uint32_t index, uint32_t end, const char* set, uint32_t count) {
+    return ROUTINES.count_any(data, index, end, set, count);
+}
+
+const char* scan_isa() {
+    return ROUTINES.isa;
+}
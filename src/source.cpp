@@ -0,0 +1,145 @@
+/**
+ * @file source.cpp
+ * @author strah19
+ * @date July 9 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * Maps source files into memory so the front end can work on them without
+ * copying the text.
+ */
+
+#include "source.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+Source::Source(const char* filepath) {
+    open(filepath);
+}
+
+Source::~Source() {
+    close();
+}
+
+/**
+ * Maps the file at the given path. An empty file is valid and results in an empty buffer.
+ *
+ * @param const char* The path to the source file.
+ * @return bool False if the file could not be opened or mapped.
+ */
+bool Source::open(const char* filepath) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    if (file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle = file;
+    mapping_handle = mapping;
+    buffer = (const char*) view;
+    length = (uint32_t) file_size.QuadPart;
+#else
+    int fd = ::open(filepath, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat sb{};
+    if (fstat(fd, &sb) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if (sb.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* view = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    // The lexer walks the file front to back exactly once.
+    madvise(view, sb.st_size, MADV_SEQUENTIAL);
+
+    buffer = (const char*) view;
+    length = (uint32_t) sb.st_size;
+#endif
+
+    mapped = true;
+    return true;
+}
+
+void Source::close() {
+    if (mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(buffer);
+        CloseHandle((HANDLE) mapping_handle);
+        CloseHandle((HANDLE) file_handle);
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+#else
+        munmap((void*) buffer, length);
+#endif
+    }
+
+    buffer = "";
+    length = 0;
+    mapped = false;
+    edited.clear();
+}
+
+/**
+ * Replaces count bytes at offset with text. The first edit copies the text out of the mapping,
+ * the buffer then moves with every edit.
+ */
+void Source::replace(uint32_t offset, uint32_t count, std::string_view text) {
+    if (buffer != edited.data()) {
+        std::string copy(buffer, length);
+        close();
+        edited = std::move(copy);
+    }
+
+    edited.replace(offset, count, text);
+    buffer = edited.data();
+    length = (uint32_t) edited.size();
+}
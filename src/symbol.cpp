@@ -0,0 +1,141 @@
+/**
+ * @file symbol.cpp
+ * @author strah19
+ * @date July 10 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * The global symbol table that interns identifiers into integer ids.
+ */
+
+#include "symbol.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Names are kept in fixed size chunks indexed by id. A chunk never moves once it is
+// allocated so symbol_name() can read it without taking the lock.
+static constexpr uint32_t NAME_CHUNK_BITS = 12;
+static constexpr uint32_t NAME_CHUNK_SIZE = 1 << NAME_CHUNK_BITS;
+static constexpr uint32_t MAX_NAME_CHUNKS = 1 << 16;
+
+static std::string_view* name_chunks[MAX_NAME_CHUNKS];
+static std::atomic<uint32_t> name_count { 0 };
+
+// The characters of the names are copied into blocks so they outlive the source they came from.
+static constexpr size_t TEXT_BLOCK_SIZE = 64 * 1024;
+static char* text_block = nullptr;
+static size_t text_used = TEXT_BLOCK_SIZE;
+
+// Open addressing table of id + 1, a 0 marks an empty slot.
+static std::vector<uint32_t> slots(1024, 0);
+static std::vector<uint32_t> hashes;
+static std::mutex table_lock;
+
+static uint32_t hash_name(std::string_view name) {
+    uint32_t hash = SYMBOL_HASH_BASIS;
+    for (char c : name)
+        hash = hash_symbol(hash, c);
+    return hash;
+}
+
+static const char* store_text(std::string_view name) {
+    if (name.size() > TEXT_BLOCK_SIZE / 4) {
+        char* text = new char[name.size()];
+        memcpy(text, name.data(), name.size());
+        return text;
+    }
+
+    if (text_used + name.size() > TEXT_BLOCK_SIZE) {
+        text_block = new char[TEXT_BLOCK_SIZE];
+        text_used = 0;
+    }
+
+    char* text = text_block + text_used;
+    memcpy(text, name.data(), name.size());
+    text_used += name.size();
+    return text;
+}
+
+static void insert_slot(std::vector<uint32_t>& table, uint32_t hash, SymbolId symbol) {
+    uint32_t mask = (uint32_t) table.size() - 1;
+    uint32_t i = hash & mask;
+    while (table[i] != 0)
+        i = (i + 1) & mask;
+    table[i] = symbol + 1;
+}
+
+static void grow_slots() {
+    std::vector<uint32_t> table(slots.size() * 2, 0);
+    for (uint32_t i = 0; i < hashes.size(); i++)
+        insert_slot(table, hashes[i], i);
+    slots.swap(table);
+}
+
+/**
+ * Returns the id of a name, adding it to the table the first time it is seen.
+ * Safe to call from several threads at once.
+ *
+ * @param std::string_view The name.
+ * @return SymbolId The id of the name.
+ */
+SymbolId intern(std::string_view name) {
+    uint32_t hash = hash_name(name);
+    std::lock_guard<std::mutex> guard(table_lock);
+
+    uint32_t mask = (uint32_t) slots.size() - 1;
+    for (uint32_t i = hash & mask; slots[i] != 0; i = (i + 1) & mask) {
+        SymbolId symbol = slots[i] - 1;
+        if (hashes[symbol] == hash && symbol_name(symbol) == name)
+            return symbol;
+    }
+
+    SymbolId symbol = name_count.load(std::memory_order_relaxed);
+    if ((symbol >> NAME_CHUNK_BITS) >= MAX_NAME_CHUNKS)
+        return SYMBOL_NONE;
+
+    std::string_view*& chunk = name_chunks[symbol >> NAME_CHUNK_BITS];
+    if (!chunk)
+        chunk = new std::string_view[NAME_CHUNK_SIZE];
+    chunk[symbol & (NAME_CHUNK_SIZE - 1)] = std::string_view(store_text(name), name.size());
+    hashes.push_back(hash);
+
+    if ((symbol + 1) * 2 > slots.size())
+        grow_slots();
+    insert_slot(slots, hash, symbol);
+
+    name_count.store(symbol + 1, std::memory_order_release);
+    return symbol;
+}
+
+/**
+ * @param SymbolId An id returned by intern.
+ * @return std::string_view The name of the symbol, empty if the id is not known.
+ */
+std::string_view symbol_name(SymbolId symbol) {
+    if (symbol >= name_count.load(std::memory_order_acquire))
+        return std::string_view();
+    return name_chunks[symbol >> NAME_CHUNK_BITS][symbol & (NAME_CHUNK_SIZE - 1)];
+}
+
+uint32_t symbol_count() {
+    return name_count.load(std::memory_order_acquire);
+}
+
+SymbolId SymbolCache::intern(std::string_view name, uint32_t hash) {
+    Entry& entry = entries[hash & (SIZE - 1)];
+    if (entry.symbol != SYMBOL_NONE && entry.name == name)
+        return entry.symbol;
+
+    entry.symbol = ::intern(name);
+    entry.name = symbol_name(entry.symbol);
+    return entry.symbol;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file thread_pool.cpp
+ * @author strah19
+ * @date July 11 2022
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the MIT License as published
+ * by the Free Software Foundation.
+ *
+ * @section DESCRIPTION
+ *
+ * A simple pool of worker threads for the parallel parts of the front end.
+ */
+
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(uint32_t threads) {
+    if (threads == 0)
+        threads = 1;
+
+    for (uint32_t i = 0; i < threads; i++)
+        workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    job_ready.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push(std::move(job));
+    }
+    job_ready.notify_one();
+}
+
+/**
+ * Blocks until every submitted job has finished.
+ */
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    jobs_done.wait(guard, [this] { return jobs.empty() && running == 0; });
+}
+
+void ThreadPool::parallel_for(uint32_t count, const std::function<void(uint32_t)>& job) {
+    for (uint32_t i = 0; i < count; i++)
+        submit([&job, i] { job(i); });
+    wait();
+}
+
+uint32_t ThreadPool::hardware_threads() {
+    uint32_t threads = std::thread::hardware_concurrency();
+    return (threads == 0) ? 1 : threads;
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            job_ready.wait(guard, [this] { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop();
+            running++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running--;
+            if (jobs.empty() && running == 0)
+                jobs_done.notify_all();
+        }
+    }
+}
+
+ThreadPool& thread_pool() {
+    static ThreadPool pool(ThreadPool::hardware_threads());
+    return pool;
+}